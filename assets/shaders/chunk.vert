@@ -0,0 +1,71 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+// 区块合并网格的压缩顶点（ChunkVertex）
+// x：位置xyz各6位（区块内坐标）、面索引3位；y：贴图编号16位、亮度8位
+layout (location = 0) in uvec2 vPacked;
+
+layout (location = 0) out vec4 objectLight;
+layout (location = 1) out vec2 texCoord;
+layout (location = 2) out float z;    // 屏幕中心到目标面渲染距离
+layout (location = 3) out vec4 fragPosLightSpace; // ShadowMap：顶点在光照空间的位置
+layout (location = 4) out vec3 fragNormal;
+layout (location = 5) flat out vec2 tileOrigin; // 贴图在材质包中的行列
+layout (location = 6) out float vertLight;      // 顶点亮度（0~1）
+
+layout(set = 0, binding = 0) uniform  CameraBuffer{
+    mat4 view;
+    mat4 proj;
+    vec4 camPos;    // 相机位置
+} cameraData;
+
+// ShadowMap：光照空间的视图和投影矩阵
+layout(set = 0, binding = 2) uniform LightSpaceBuffer {
+    mat4 lightView;
+    mat4 lightProj;
+} lightSpaceData;
+
+// 紧凑的物体记录，与vk_types.h中的GPUObjectData一致，区块网格的面索引为OBJECT_FACE_NONE（不旋转）
+struct ObjectData{
+    uint xy;        // 区块原点的世界坐标x、y（各16位有符号）
+    uint zFaceTile; // 区块原点的世界坐标z（16位有符号）、面索引、贴图编号（不使用）
+    uint light;     // 物体自身光强RGB和所在格亮度（各8位）
+};
+
+layout(std430,set = 1, binding = 0) readonly buffer ObjectBuffer{
+    ObjectData objects[];
+} objectBuffer;
+
+// 实例序号到物体槽位的映射：同一网格的物体在其中连续存放，实例化绘制时gl_InstanceIndex依次取到它们
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer{
+    uint objectIds[];
+} instanceBuffer;
+
+const int TEXTURE_SIZE = 16; // 正方形材质包边长
+
+// 与chunk_mesher.h中的MESH_FACE_DIR、MESH_FACE_AXIS_U/V一致（面顺序FRUDLB）
+const vec3 FACE_DIR[6] = vec3[](vec3(0, 0, -1), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(1, 0, 0), vec3(0, 0, 1));
+const vec3 FACE_AXIS_U[6] = vec3[](vec3(1, 0, 0), vec3(0, 0, -1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(0, 0, 1), vec3(-1, 0, 0));
+const vec3 FACE_AXIS_V[6] = vec3[](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, 1, 0), vec3(0, 1, 0));
+
+void main()
+{
+    const ObjectData object = objectBuffer.objects[instanceBuffer.objectIds[gl_InstanceIndex]];
+    const vec3 position = vec3(vPacked.x & 63u, (vPacked.x >> 6) & 63u, (vPacked.x >> 12) & 63u);
+    const uint face = (vPacked.x >> 18) & 7u;
+    const int tile = int(vPacked.y & 65535u);
+
+    const ivec3 chunkOrigin = ivec3(bitfieldExtract(int(object.xy), 0, 16), bitfieldExtract(int(object.xy), 16, 16), bitfieldExtract(int(object.zFaceTile), 0, 16));
+    const vec4 worldPos = vec4(vec3(chunkOrigin) + position, 1.0f); // 只有平移到区块原点
+    const vec4 viewPos = cameraData.view * worldPos;
+    gl_Position = cameraData.proj * viewPos;
+    // 位置沿面内u/v轴的投影，与四边形起点只差整数，fract后与逐面的贴图坐标相同
+    texCoord = vec2(dot(position, FACE_AXIS_U[face]), dot(position, FACE_AXIS_V[face]));
+    z = viewPos.z / viewPos.w;
+
+    tileOrigin = vec2(tile % TEXTURE_SIZE, tile / TEXTURE_SIZE);
+    vertLight = float((vPacked.y >> 16) & 255u) / 255.0;
+
+    objectLight = unpackUnorm4x8(object.light);
+    fragPosLightSpace = lightSpaceData.lightProj * lightSpaceData.lightView * worldPos;
+    fragNormal = FACE_DIR[face]; // 区块网格不旋转
+}
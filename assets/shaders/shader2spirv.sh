@@ -24,8 +24,8 @@ if [ ! -f "$GLSLC" ]; then
     exit 1
 fi
 
-# 查找所有 .vert 和 .frag 文件
-shader_files=$(find . -type f \( -name "*.vert" -o -name "*.frag" \))
+# 查找所有 .vert、.frag 和 .comp 文件
+shader_files=$(find . -type f \( -name "*.vert" -o -name "*.frag" -o -name "*.comp" \))
 
 # 初始化编译失败标志
 compile_failed=false
@@ -18,7 +18,7 @@ layout(set = 0, binding = 0) uniform  CameraBuffer{
 } cameraData;
 layout(set = 0, binding = 1) uniform  SceneData{
     vec4 fogColor; // w is for exponent
-    vec4 fogDistance; //x for min, y for max, z 越大雾气扩大速度越慢, w unused.
+    vec4 fogDistance; //x for min, y for max, z 越大雾气扩大速度越慢, w为1时采样阴影贴图
     vec4 ambientColor;
     vec4 sunPos; //w for sun power
     vec4 sunlightColor; // w为天空颜色反射率（决定方块整体反射天空颜色的程度）
@@ -53,7 +53,7 @@ void main()
     vec3 color = (texColor.xyz + sceneData.fogColor.xyz * fogDensity) * sceneData.ambientColor.xyz;	// 材质包原色理解成是#FFFFFF下的反射效果，乘以天空颜色相当于按天空光缩小亮度
 
     // ShadowMap
-    float shadow = ShadowCalculation(fragPosLightSpace);
+    float shadow = sceneData.fogDistance.w > 0.5 ? ShadowCalculation(fragPosLightSpace) : 0.0;
     color *= (1.0 - shadow);
 
     outFragColor = vec4(color, texColor.w);
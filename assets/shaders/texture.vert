@@ -4,7 +4,7 @@
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec3 vColor;
-layout (location = 3) in vec2 vTexCoord;
+layout (location = 3) in vec2 vTexCoord; // 单位面内坐标，贴图由物体数据中的编号决定
 
 layout (location = 0) out vec4 objectLight;
 layout (location = 1) out vec2 texCoord;
@@ -24,30 +24,51 @@ layout(set = 0, binding = 2) uniform LightSpaceBuffer {
     mat4 lightProj;
 } lightSpaceData;
 
+// 紧凑的物体记录，与vk_types.h中的GPUObjectData一致
 struct ObjectData{
-    mat4 model;
-    vec4 objectLight;  // 物体自身光强，xyz为自身光照色彩，w所在格亮度（1.0满亮度）
-    vec4 normal;
+    uint xy;        // 世界坐标x、y（各16位有符号）
+    uint zFaceTile; // 世界坐标z（16位有符号）、面索引（8位）、贴图编号（8位）
+    uint light;     // 物体自身光强RGB和所在格亮度（各8位），解包后xyz为自身光照色彩，w所在格亮度（1.0满亮度）
 };
 
-//all object matrices, std140 是内存布局规则，使用它可以与C++的数组运行模式匹配；set = 1对应区别于camera使用的另一个DescriptorSet；readonly buffer告知这是一个只读的buffer
-layout(std140,set = 1, binding = 0) readonly buffer ObjectBuffer{
+//all objects, std430 是内存布局规则，三个uint紧密排列（每个物体12字节）；set = 1对应区别于camera使用的另一个DescriptorSet；readonly buffer告知这是一个只读的buffer
+layout(std430,set = 1, binding = 0) readonly buffer ObjectBuffer{
     ObjectData objects[];
 } objectBuffer;
 
+// 实例序号到物体槽位的映射：同一网格的物体在其中连续存放，实例化绘制时gl_InstanceIndex依次取到它们
+layout(std430, set = 1, binding = 1) readonly buffer InstanceBuffer{
+    uint objectIds[];
+} instanceBuffer;
+
+const int TEXTURE_SIZE = 16; // 正方形材质包边长
+
+// 与chunk_mesher.h中的MESH_FACE_DIR、MESH_FACE_ORIGIN、MESH_FACE_AXIS_U/V一致（面顺序FRUDLB）
+const vec3 FACE_DIR[6] = vec3[](vec3(0, 0, -1), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(1, 0, 0), vec3(0, 0, 1));
+const ivec3 FACE_ORIGIN[6] = ivec3[](ivec3(0, 0, 0), ivec3(0, 0, 1), ivec3(0, 1, 0), ivec3(0, 0, 1), ivec3(1, 0, 0), ivec3(1, 0, 1));
+const vec3 FACE_AXIS_U[6] = vec3[](vec3(1, 0, 0), vec3(0, 0, -1), vec3(1, 0, 0), vec3(1, 0, 0), vec3(0, 0, 1), vec3(-1, 0, 0));
+const vec3 FACE_AXIS_V[6] = vec3[](vec3(0, 1, 0), vec3(0, 1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, 1, 0), vec3(0, 1, 0));
+
 void main()
 {
-    const mat4 modelMatrix = objectBuffer.objects[gl_InstanceIndex].model;
-    const mat4 vm = cameraData.view * modelMatrix;
-    const vec4 viewPos = vm * vec4(vPosition, 1.0f);
+    const ObjectData object = objectBuffer.objects[instanceBuffer.objectIds[gl_InstanceIndex]];
+    const ivec3 blockPos = ivec3(bitfieldExtract(int(object.xy), 0, 16), bitfieldExtract(int(object.xy), 16, 16), bitfieldExtract(int(object.zFaceTile), 0, 16));
+    const uint face = bitfieldExtract(object.zFaceTile, 16, 8);
+    // 面的旋转把单位面的x/y轴转到面内u/v轴，再平移到方块上该面的原点
+    const mat3 rotation = mat3(FACE_AXIS_U[face], FACE_AXIS_V[face], cross(FACE_AXIS_U[face], FACE_AXIS_V[face]));
+    const vec4 worldPos = vec4(vec3(blockPos + FACE_ORIGIN[face]) + rotation * vPosition, 1.0f);
+    const vec4 viewPos = cameraData.view * worldPos;
     gl_Position = cameraData.proj * viewPos;
-    texCoord = vTexCoord;
+    // 贴图编号换算成材质包中的行列，面内坐标的x、y方向都要颠倒
+    const int tile = int(object.zFaceTile >> 24);
+    const vec2 tileOrigin = vec2(tile % TEXTURE_SIZE, tile / TEXTURE_SIZE);
+    texCoord = (vec2(1.0) - vTexCoord + tileOrigin) / TEXTURE_SIZE;
     z = viewPos.z / viewPos.w;
 
     // ShadowMap
-    objectLight = objectBuffer.objects[gl_InstanceIndex].objectLight;
+    objectLight = unpackUnorm4x8(object.light);
     // 计算顶点在光照空间的位置
-    fragPosLightSpace = lightSpaceData.lightProj * lightSpaceData.lightView * modelMatrix * vec4(vPosition, 1.0);
-    // 传递法线信息，进行模型矩阵变换并归一化
-    fragNormal = normalize(mat3(transpose(inverse(modelMatrix))) * vNormal); 
+    fragPosLightSpace = lightSpaceData.lightProj * lightSpaceData.lightView * worldPos;
+    // 面的法线（只有旋转，不需要逆转置矩阵）
+    fragNormal = FACE_DIR[face];
 }
@@ -0,0 +1,47 @@
+// 生物群系与气候图：缓变的气候场只在低分辨率网格上计算，再双线性插值到每一列
+
+#ifndef BIOME_H
+#define BIOME_H
+
+#include <chunk.h>
+#include <cstdint>
+
+static const int BIOME_CELL = 4;                                              // 气候网格间距（列），越大噪声调用越少，但群系过渡越粗糙
+static const int BIOME_GRID_LEN = CHUNK_LEN * CHUNK_MAX_XZ / BIOME_CELL + 1; // 覆盖整个世界所需的网格点数（含右边界）
+
+enum BIOME_ENUM
+{
+    BIOME_PLAIN,   // 平原
+    BIOME_HILLS,   // 丘陵（平原与山地的过渡带）
+    BIOME_MOUNTAIN // 山地
+};
+
+// 一个气候采样点上的缓变场
+struct ClimateSample
+{
+    float continent;   // 大陆性
+    float erosion;     // 侵蚀性
+    float peak_valley; // 山脊/山谷性
+    float mix;         // 山地/平原混合权重，1为纯平原，0为纯山地
+    float ridge;       // 山地的大尺度起伏（低频细胞噪声）
+};
+
+// 清空气候网格（新世界创建时调用）
+void init_climate_map();
+
+// 预先计算[x_min, x_max) * [z_min, z_max)范围覆盖的全部网格点，多线程生成前调用以避免并发写网格
+void prepare_climate_map(int x_min, int z_min, int x_max, int z_max);
+
+// 气候的指纹：网格间距和若干固定网格点上的气候，气候噪声参数变化后预生成的区块即失效
+uint64_t climate_fingerprint();
+
+// 获取(x, z)列插值后的气候
+ClimateSample sample_climate(int x, int z);
+
+// 依据气候划分群系
+BIOME_ENUM get_biome(const ClimateSample &climate);
+
+// 群系地表覆盖的方块
+BLOCK_ENUM get_biome_surface_block(BIOME_ENUM biome);
+
+#endif /* BIOME_H */
@@ -42,6 +42,14 @@ public:
     int cx, cy, cz;                                 // 区块位置
     bool rendered = false;                          // 该区块是否已经被渲染（避免重复渲染）
     bool built = false;                             // 该区块是否有建筑盘踞（一个区块最多只能有一所建筑）
+    Mesh *mesh = nullptr;                           // 合并后的区块网格（CHUNK_MESHING），没有可见面时为空
+    int mesh_id = FACE_UNRENDERED;                  // 区块网格在__renderables中的索引
+    Mesh *translucent_mesh = nullptr;               // 透明方块单独组成的网格，按相机距离排序后绘制
+    int translucent_mesh_id = FACE_UNRENDERED;      // 半透明网格在__renderables中的索引
+    bool translucent_sorted = false;                // 半透明网格是否已经按sort_camera_pos排过序
+    glm::vec3 sort_camera_pos;                      // 上次排序时的相机位置
+    bool dirty = false;                             // 方块变化后等待重新网格化
+    unsigned mesh_version = 0;                      // 每次重新网格化或取消渲染时加一，用来丢弃过期的后台网格化结果
 
     Chunk(int p_rx, int p_ry, int p_rz);
     Chunk(int p_rx, int p_ry, int p_rz, bool p_built);
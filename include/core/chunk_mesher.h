@@ -0,0 +1,90 @@
+// 区块网格化：把区块内所有可见面按贪心算法合并成较大的四边形，每个区块只生成一个顶点缓冲
+// 相邻、共面且纹理相同的面合并为一个w * h的矩形，片元着色器按面内坐标重复贴图
+
+#ifndef CHUNK_MESHER_H
+#define CHUNK_MESHER_H
+
+#include <chunk.h>
+#include <vector>
+#include <cstdint>
+
+static_assert(CHUNK_LEN + 2 <= 64, "a chunk column with its neighbours must fit in a 64-bit mask");
+static_assert(CHUNK_LEN < 64, "chunk-local vertex coordinates are packed into 6 bits");
+static_assert(CHUNK_LEN % 4 == 0, "LOD cells of 4 blocks must tile a chunk");
+
+static const int MESH_PAD = CHUNK_LEN + 2; // 区块加上一圈邻居方块的边长
+static const int MESH_LIGHT_FULL = 255; // 压缩顶点的亮度（不遮挡）
+static const uint8_t MESH_AO_NONE = 0xFF; // 四个角都不遮挡（每角2位，等级3）
+static const int MESH_QUAD_MAX = CHUNK_LEN_CUBIC * 6; // 一个区块网格最多的四边形数（所有方块六个面都可见），共享四边形索引缓冲按此分配
+static const int MESH_LOD_FULL_RADIUS = 2; // 离中心区块该距离（区块）以内全精度网格化
+static const int MESH_LOD_HALF_RADIUS = 3; // 该距离以内按2×2×2合并方块网格化，更远按4×4×4
+
+static const int FACE_F = 0, FACE_R = 1, FACE_U = 2, FACE_D = 3, FACE_L = 4, FACE_B = 5; // 方块的六个面对应的索引
+
+// 以下四个表与RenderSystem中的BLOCK_DIR以及着色器中的FACE_DIR、FACE_ORIGIN、FACE_AXIS_U/V一一对应（面顺序FRUDLB），
+// 逐面渲染时单位正方形的x/y轴被旋转到MESH_FACE_AXIS_U/V，这里直接写成整数避免浮点误差
+static const glm::ivec3 MESH_FACE_DIR[6] = {{0, 0, -1}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {1, 0, 0}, {0, 0, 1}};  // 面朝向的相邻方块
+static const glm::ivec3 MESH_FACE_ORIGIN[6] = {{0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 0, 1}, {1, 0, 0}, {1, 0, 1}}; // 面的原点相对方块的偏移
+static const glm::ivec3 MESH_FACE_AXIS_U[6] = {{1, 0, 0}, {0, 0, -1}, {1, 0, 0}, {1, 0, 0}, {0, 0, 1}, {-1, 0, 0}}; // 面内x轴（贴图u方向）
+static const glm::ivec3 MESH_FACE_AXIS_V[6] = {{0, 1, 0}, {0, 1, 0}, {0, 0, 1}, {0, 0, -1}, {0, 1, 0}, {0, 1, 0}};  // 面内y轴（贴图v方向）
+
+// 合并后的一个四边形，覆盖从方块pos起沿面内u/v轴的w * h个方块面
+struct ChunkQuad
+{
+    glm::ivec3 pos; // 起始方块的区块内坐标
+    int face;       // 面索引（FRUDLB）
+    int w, h;       // 沿MESH_FACE_AXIS_U/V覆盖的方块数
+    BLOCK_ENUM tile; // 贴图在材质包中的编号
+    uint8_t ao = MESH_AO_NONE; // 四个角的环境光遮蔽等级，角点(cu, cv)占第(cu + 2 * cv) * 2起的2位
+};
+
+// 方块某个面使用的贴图（草方块和TNT的顶面/底面与侧面不同）
+BLOCK_ENUM block_face_tile(BLOCK_ENUM kind, int face);
+
+// 贪心合并区块内的所有可见面，可见性规则与RenderSystem::render_block一致：
+// 不透明方块的面朝向空气或未生成的区块时可见，透明方块总是渲染全部六个面
+void mesh_chunk_greedy(const Chunk *chunk, std::vector<ChunkQuad> &quads);
+
+// 与mesh_chunk_greedy覆盖相同面的位运算实现：区块连同一圈邻居按三个方向打包成64位占用列，
+// 整列移位和与非运算求出暴露的面，只访问置位的方块，再在位平面上贪心合并；
+// 同时按相邻方块计算每个顶点的环境光遮蔽，只合并遮蔽相同且四角一致的面
+void mesh_chunk_binary(const Chunk *chunk, std::vector<ChunkQuad> &quads);
+
+static const uint8_t SNAPSHOT_SOLID = 1;       // 非空气方块（邻居中世界边界外的位置也算）
+static const uint8_t SNAPSHOT_TRANSPARENT = 2; // 透明方块
+
+// 区块网格的细节层次：按到中心区块的距离返回合并边长1、2或4
+int chunk_lod_scale(glm::ivec3 cpos, glm::ivec3 center);
+
+// 网格化所需的区块数据副本（含一圈邻居），在主线程拍下后交给工作线程，工作线程不访问__chunks
+struct ChunkSnapshot
+{
+    glm::ivec3 cpos;                                   // 区块位置
+    uint8_t cells[MESH_PAD][MESH_PAD][MESH_PAD];       // SNAPSHOT_*标记，下标整体偏移1
+    BLOCK_ENUM kinds[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN]; // 区块内方块种类（决定贴图）
+    int lod_scale = 1;                                 // 大于1时把lod_scale^3个方块合并成一格再网格化
+    // lod_scale > 1时六个方向上相邻区块贴边一层粗格是否实心，[面][另外两轴的粗格坐标（升序）]
+    uint8_t lod_near[6][CHUNK_LEN][CHUNK_LEN];
+};
+
+// lod_center非空时按到它的距离决定区块及其邻居的细节层次：精度不同的邻居视为空气，
+// 两侧各自封闭交界面，不会因为粗细网格的表面不一致而出现裂缝
+void snapshot_chunk(const Chunk *chunk, ChunkSnapshot &snapshot, const glm::ivec3 *lod_center = nullptr);
+
+// mesh_chunk_binary的线程安全部分，只读取快照；translucent_quads非空时透明方块的面单独输出到其中。
+// 快照的lod_scale大于1时改为粗格网格化：不透明方块不少于一半的格为实心，顶面取格内最高处的方块，
+// 其余面取格内最多的方块，透明方块忽略，不计算环境光遮蔽
+void mesh_snapshot_binary(const ChunkSnapshot &snapshot, std::vector<ChunkQuad> &quads, std::vector<ChunkQuad> *translucent_quads = nullptr);
+
+// 把四边形展开成4个压缩顶点（区块内坐标、面索引、贴图编号和由遮蔽等级得到的亮度），按QUAD_INDEX_PATTERN绘制，
+// 以方块为单位的面内坐标在着色器中由位置沿MESH_FACE_AXIS_U/V投影得到（超过1时重复贴图）
+void build_chunk_vertices(const std::vector<ChunkQuad> &quads, std::vector<ChunkVertex> &vertices);
+
+// 由四边形生成CPU侧区块网格，没有四边形时返回空；不透明网格使用共享的四边形索引，
+// 半透明网格带有自己的索引和每个四边形的中心，供sort_translucent_quads排序
+Mesh *create_chunk_mesh(const std::vector<ChunkQuad> &quads, bool translucent);
+
+// 按到相机（区块内坐标）的距离从远到近重排半透明网格的索引，顶点不动
+void sort_translucent_quads(Mesh *mesh, glm::vec3 camera_local);
+
+#endif /* CHUNK_MESHER_H */
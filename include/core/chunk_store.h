@@ -0,0 +1,30 @@
+// 区块持久化：每个区块一个文件，存放全部方块种类，供离线预生成工具写入、游戏加载区块时读取
+
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include <chunk.h>
+#include <cstdint>
+#include <string>
+
+#define WORLD_DIR "./world/"
+
+static const unsigned CHUNK_STORE_MAGIC = 0x4B484356; // "VCHK"
+static const unsigned CHUNK_STORE_VERSION = 2;        // 世界生成算法变化后需要递增，旧文件会被忽略
+
+// 区块文件路径
+std::string chunk_store_path(int cx, int cy, int cz);
+
+// 设置世界生成器的指纹（地形噪声图和气候），保存时写入文件头；指纹不同的区块文件视为过期，读取时忽略
+void set_chunk_store_fingerprint(uint64_t fingerprint);
+
+// 该区块是否已经保存过，且文件头与当前版本、区块边长、坐标和世界生成器指纹都一致
+bool chunk_stored(int cx, int cy, int cz);
+
+// 保存区块的全部方块种类，先写临时文件再改名，中途中断不会留下损坏的区块文件
+bool save_chunk(const Chunk *chunk);
+
+// 从文件读取区块的全部方块，chunk中的方块必须为空；找不到文件或文件不匹配（含世界生成器指纹）时返回false
+bool load_chunk(Chunk *chunk);
+
+#endif /* CHUNK_STORE_H */
@@ -228,7 +228,9 @@ static void get_input()
 
     // 调试用，非正常游戏功能！
     if (isKeyDown(GLFW_KEY_UP))
-    {
+    { // 切换GPU剔除，对比开关前后的帧率和提交物体数
+        __gpu_culling = !__gpu_culling;
+        cout << "GPU culling " << (__gpu_culling ? "on" : "off") << endl;
     }
     else if (isKeyUp(GLFW_KEY_UP))
     {
@@ -3,7 +3,11 @@
 #define LEVEL_SYSTEM_H
 
 #include <chunk.h>
+#include <biome.h>
+#include <chunk_store.h>
 #include <noise.h>
+#include <noise_cache.h>
+#include <noise_graph.h>
 #include <spline.h>
 #include <chrono>
 
@@ -25,20 +29,22 @@ static LevelSystem __main_level;
 #define GENERATE_CAVE true
 #define GENERATE_SKYBLOCK false
 #define GENERATE_BUILDING false
+#define LOAD_CHUNK_STORE true // 优先从WORLD_DIR读取预生成的区块
+#define TERRAIN_GRAPH_FILE "./terrain.graph"
 
 static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing);
+static const NoiseGraph &terrain_graph();
 
-// 石头地基生成
+// 石头地基生成（样条取值来自低分辨率气候图）
 static inline int terrain_base_height(int x, int z)
 {
     int base = 35;
-    int amp = 35;    // 越大地形起伏越大
-    float f = 0.015; // 越大地形变化越快
-    float noise = perlinNoise(glm::vec2(x * f, z * f));
+    int amp = 35; // 越大地形起伏越大
+    ClimateSample climate = sample_climate(x, z);
     // 下面每个噪声参数都要乘权重，加起来要等于1
-    float n1 = spline::continent(noise) * 0.5;
-    float n2 = spline::peak_valley(noise) * 0.1;
-    float n3 = spline::erosion(noise) * 0.4;
+    float n1 = climate.continent * 0.5;
+    float n2 = climate.peak_valley * 0.1;
+    float n3 = climate.erosion * 0.4;
     return base + amp * (n1 + n2 + n3);
 }
 
@@ -47,32 +53,38 @@ static int __terrain_heights[CHUNK_LEN * CHUNK_MAX_XZ][CHUNK_LEN * CHUNK_MAX_XZ]
 static inline void init_terrain_heights()
 {
     memset(__terrain_heights, 0, sizeof(__terrain_heights));
+    init_climate_map();
+    uint64_t fingerprint = terrain_graph().fingerprint();
+    fingerprint = fnv1a_hash(&fingerprint, sizeof(fingerprint), climate_fingerprint());
+    set_chunk_store_fingerprint(fingerprint);
 }
 
-static void generate_terrain_height(glm::vec2 xz)
+// 地表高度的逐列标量实现，作为噪声图的对照（check_terrain_graph）
+static float terrain_height_reference(glm::vec2 xz)
 {
-    if (__terrain_heights[(int)xz.x][(int)xz.y] > 0)
-        return; // 已经在之前生成过了，就不浪费时间了
-                //    int base = 40;
-                //    int amp = 40;   // 越大地形起伏越大
-                //    float f = 0.015; // 越大地形变化越快
-                //    float noise = perlinNoise(glm::vec2(x * f, z * f));
-                //    // 下面每个噪声参数都要乘权重，加起来要等于1
-                //    float n1 = spline::continent(noise) * 0.5;
-                //    float n2 = spline::peak_valley(noise) * 0.3;
-                //    float n3 = spline::erosion(noise) * 0.2;
-                //    return base + amp * (n1 + n2 + n3);
+    //    int base = 40;
+    //    int amp = 40;   // 越大地形起伏越大
+    //    float f = 0.015; // 越大地形变化越快
+    //    float noise = perlinNoise(glm::vec2(x * f, z * f));
+    //    // 下面每个噪声参数都要乘权重，加起来要等于1
+    //    float n1 = spline::continent(noise) * 0.5;
+    //    float n2 = spline::peak_valley(noise) * 0.3;
+    //    float n3 = spline::erosion(noise) * 0.2;
+    //    return base + amp * (n1 + n2 + n3);
+
+    // 缓变场（混合权重、山地起伏）统一从低分辨率气候图插值，每列只计算高频细节
+    ClimateSample climate = sample_climate((int)xz.x, (int)xz.y);
 
     // Noise generation
     float n1 = 0, n2 = 0, n3 = 0, n4 = 0;
     float ran = 0, ran_1 = 0, ran_2 = 0, ran_3 = 0;
     // Flat terrain，平原地形是若干噪声函数的叠加
     float a = 0, b = 1, c = 1, d = 0.1;
-    n1 = perlinNoise((xz + vec2(1000)) / 60.f); // 低频柏林
+    n1 = perlinNoiseCached((xz + vec2(1000)) / 60.f); // 低频柏林
     n1 = 1 - abs(n1);
-    n2 = 0.5 * (perlinNoise((xz + vec2(100)) / 150.f) + 1.f); // 高频柏林
-    n3 = fbm((xz) / 250.f);
-    n4 = worleyNoise(xz / 100.f); // 细胞噪声
+    n2 = 0.5 * (perlinNoiseCached((xz + vec2(100)) / 150.f) + 1.f); // 高频柏林
+    n3 = fbmCached((xz) / 250.f);
+    n4 = worleyNoiseCached(xz / 100.f); // 细胞噪声
     ran_1 = n1 * a + n2 * b + n3 * c + n4 * d;
     ran_1 = ran_1 / (a + b + c + d); // 齐次化
     ran_1 = 40 * pow(ran_1, 2.5);    // 放大化
@@ -85,7 +97,7 @@ static void generate_terrain_height(glm::vec2 xz)
     float freq = 64;
     for (int j = 0; j < 4; ++j) // 傅立叶变换叠加
     {
-        float h1 = perlinNoise(xz / freq);
+        float h1 = perlinNoiseCached(xz / freq);
         h1 = 1 - abs(h1);
 
         n1 += h1 * amp;
@@ -94,32 +106,140 @@ static void generate_terrain_height(glm::vec2 xz)
         amp *= 0.5;
     }
 
-    n2 = 0.5 * (perlinNoise((xz + vec2(100)) / 60.f) + 1.f); // 噪声偏移
-    n3 = fbm((xz) / 200.f);
-    n4 = fbm((xz + vec2(50)) / 400.f);
+    n2 = 0.5 * (perlinNoiseCached((xz + vec2(100)) / 60.f) + 1.f); // 噪声偏移
+    n3 = fbmCached((xz) / 200.f);
+    n4 = 0; // 权重d为0，省去fbm((xz + vec2(50)) / 400.f)
 
     ran_2 = n1 * a + n2 * b + n3 * c + n4 * d;
     ran_2 = ran_2 / (a + b + c + d);
-    ran_2 = (140 * pow(ran_2, 1) + 100 * (worleyNoise(vec2(xz / 200.f)) + fbm(xz / 500.f))) / 2;
+    ran_2 = (140 * pow(ran_2, 1) + 100 * (climate.ridge + fbmCached(xz / 500.f))) / 2; // 低频细胞噪声取气候图插值
 
-    // Mountain vs plain mixing 混合权重生成
-    a = 1, b = 0, c = 1, d = 1;
+    // Mountain vs plain mixing 混合权重属于缓变场，直接取气候图插值
+    ran_3 = climate.mix;
 
-    n1 = worleyNoise((xz + vec2(10)) / 200.0f);
-    n2 = perlinNoise((xz + vec2(1000)) / 300.0f);
-    n2 = 1 - abs(n2);
-    n3 = fbm((xz) / 400.f);
-    n4 = fbm((xz) / 200.f);
+    // Terrain combination 依据上面的权重整合地形
+    ran = (1 - ran_3) * ran_2 + ran_3 * ran_1;
+    return ran;
+}
 
-    ran_3 = n1 * a + n2 * b + n3 * c + n4 * d;
-    ran_3 = ran_3 / (a + b + c + d);
+// 用噪声图描述与terrain_height_reference相同的地形，权重为0的项和常量运算在建图时被消去
+static NoiseGraph build_terrain_graph()
+{
+    NoiseGraph g;
+    int one = g.constant(1), half = g.constant(0.5);
+    int mix = g.input("mix"), ridge = g.input("ridge");
 
-    float exp = worleyNoise((xz + vec2(3000)) / 400.f);
-    ran_3 = 1 - pow(ran_3, 4 * exp);
+    // Flat terrain
+    float a = 0, b = 1, c = 1, d = 0.1;
+    int n1 = g.sub(one, g.abs(g.perlin(vec2(1000), 60)));
+    int n2 = g.mul(half, g.add(g.perlin(vec2(100), 150), one));
+    int n3 = g.fbm(vec2(0), 250);
+    int n4 = g.worley(vec2(0), 100);
+    int ran_1 = g.add(g.add(g.add(g.mul(n1, g.constant(a)), g.mul(n2, g.constant(b))), g.mul(n3, g.constant(c))), g.mul(n4, g.constant(d)));
+    ran_1 = g.div(ran_1, g.add(g.add(g.add(g.constant(a), g.constant(b)), g.constant(c)), g.constant(d)));
+    ran_1 = g.mul(g.constant(40), g.pow(ran_1, g.constant(2.5)));
+
+    // Mountainous terrain
+    a = 4, b = 3, c = 10, d = 0;
+    n1 = g.constant(0);
+    float amp = 0.5;
+    float freq = 64;
+    for (int j = 0; j < 4; ++j)
+    {
+        int h1 = g.sub(one, g.abs(g.perlin(vec2(0), freq)));
+        n1 = g.add(n1, g.mul(h1, g.constant(amp)));
+        freq *= 0.5;
+        amp *= 0.5;
+    }
+    n2 = g.mul(half, g.add(g.perlin(vec2(100), 60), one));
+    n3 = g.fbm(vec2(0), 200);
+    n4 = g.fbm(vec2(50), 400);
+    int ran_2 = g.add(g.add(g.add(g.mul(n1, g.constant(a)), g.mul(n2, g.constant(b))), g.mul(n3, g.constant(c))), g.mul(n4, g.constant(d)));
+    ran_2 = g.div(ran_2, g.add(g.add(g.add(g.constant(a), g.constant(b)), g.constant(c)), g.constant(d)));
+    ran_2 = g.div(g.add(g.mul(g.constant(140), g.pow(ran_2, one)), g.mul(g.constant(100), g.add(ridge, g.fbm(vec2(0), 500)))), g.constant(2));
+
+    // Terrain combination
+    g.set_output(g.add(g.mul(g.sub(one, mix), ran_2), g.mul(mix, ran_1)));
+    return g;
+}
 
-    // Terrain combination 依据上面的权重整合地形
-    ran = (1 - ran_3) * ran_2 + ran_3 * ran_1;
-    __terrain_heights[(int)xz.x][(int)xz.y] = floor(ran); // 可以加上地基高度
+// 地形噪声图，存在TERRAIN_GRAPH_FILE时从文件读取（输入通道为mix和ridge），否则使用代码中搭建的图
+static const NoiseGraph &terrain_graph()
+{
+    static const NoiseGraph graph = []()
+    {
+        NoiseGraph g;
+        if (!g.load_from_file(TERRAIN_GRAPH_FILE))
+            return build_terrain_graph();
+        for (const std::string &name : g.input_names())
+            if (name != "mix" && name != "ridge")
+            {
+                printf("Terrain graph %s: unknown input %s, using built-in graph\n", TERRAIN_GRAPH_FILE, name.c_str());
+                return build_terrain_graph();
+            }
+        printf("Loaded terrain graph %s\n", TERRAIN_GRAPH_FILE);
+        return g;
+    }();
+    return graph;
+}
+
+// 用噪声图批量求区块列(cx, cz)内所有x/z的地表高度（未取整），返回列数
+static int evaluate_terrain_heights(int cx, int cz, glm::vec2 *xz, float *heights)
+{
+    int x_min = cx * CHUNK_LEN, z_min = cz * CHUNK_LEN;
+    const NoiseGraph &graph = terrain_graph();
+    float mix[CHUNK_LEN * CHUNK_LEN], ridge[CHUNK_LEN * CHUNK_LEN];
+    int n = 0;
+    for (int x = x_min; x < x_min + CHUNK_LEN; ++x)
+        for (int z = z_min; z < z_min + CHUNK_LEN; ++z, ++n)
+        {
+            ClimateSample climate = sample_climate(x, z);
+            xz[n] = glm::vec2(x, z);
+            mix[n] = climate.mix;
+            ridge[n] = climate.ridge;
+        }
+    // 文件中的图可能只用到其中一个输入，或按不同顺序声明
+    std::vector<const float *> inputs(graph.input_names().size(), nullptr);
+    int mix_slot = graph.input_slot("mix"), ridge_slot = graph.input_slot("ridge");
+    if (mix_slot >= 0)
+        inputs[mix_slot] = mix;
+    if (ridge_slot >= 0)
+        inputs[ridge_slot] = ridge;
+    graph.evaluate(xz, n, inputs.data(), heights);
+    return n;
+}
+
+// 批量生成区块列(cx, cz)内所有x/z的地表高度
+static void generate_terrain_heights(int cx, int cz)
+{
+    int x_min = cx * CHUNK_LEN, z_min = cz * CHUNK_LEN;
+    if (__terrain_heights[x_min][z_min] > 0)
+        return; // 已经在之前生成过了，就不浪费时间了
+
+    glm::vec2 xz[CHUNK_LEN * CHUNK_LEN];
+    float heights[CHUNK_LEN * CHUNK_LEN];
+    int n = evaluate_terrain_heights(cx, cz, xz, heights);
+    for (int i = 0; i < n; ++i)
+        __terrain_heights[(int)xz[i].x][(int)xz[i].y] = floor(heights[i]); // 可以加上地基高度
+}
+
+// 用逐列标量实现校验区块列(cx, cz)的噪声图结果，返回超出容差的列数（VenomMeshCheck -t）
+static int check_terrain_graph(int cx, int cz)
+{
+    glm::vec2 xz[CHUNK_LEN * CHUNK_LEN];
+    float heights[CHUNK_LEN * CHUNK_LEN];
+    int n = evaluate_terrain_heights(cx, cz, xz, heights), mismatch = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        // 标量路径中pow以double计算，噪声图的噪声节点按SSE单精度计算，因此只要求在容差内一致
+        float expected = terrain_height_reference(xz[i]);
+        if (std::abs(heights[i] - expected) > 1e-3f * std::max(1.f, std::abs(expected)))
+        {
+            printf("Terrain graph mismatch at (%d, %d): %f vs %f\n", (int)xz[i].x, (int)xz[i].y, heights[i], expected);
+            ++mismatch;
+        }
+    }
+    return mismatch;
 }
 
 // 生成洞穴
@@ -372,24 +492,10 @@ static void generate_town(int x, int z, int max_r, int gap)
     }
 }
 
-// 首次创建区块并填充方块
-static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing)
+// 填充区块的自然地形（不含建筑），只写入该区块自身和它所在列的地表高度，不访问__chunks，可在多个线程中对不同列并行调用
+static void fill_chunk(Chunk *chunk)
 {
-    if (cx < 0 || cy < 0 || cz < 0)
-        return nullptr;
-    Chunk *chunk = get_chunk(cx, cy, cz);
-    if (chunk)
-    {
-        if (constructing)
-        {                        // 自然用地划为建筑用地
-            chunk->built = true; // 配合建完
-        }
-        return chunk; // 如果已经有区块，则返回
-    }
-
-    // 创建区块，新建的地事先声明用作建筑用地
-    chunk = set_chunk(cx, cy, cz, new Chunk(cx, cy, cz, constructing));
-
+    int cx = chunk->cx, cy = chunk->cy, cz = chunk->cz;
     int x_min = cx * CHUNK_LEN;
     int y_min = cy * CHUNK_LEN;
     int z_min = cz * CHUNK_LEN;
@@ -411,18 +517,19 @@ static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing)
     }
 
     // 泥土地基
+    generate_terrain_heights(cx, cz);
     for (int x = x_min; x < x_max; ++x)
     {
         for (int z = z_min; z < z_max; ++z)
         {
-            generate_terrain_height(glm::vec2(x, z));
             int th = __terrain_heights[x][z];
             int ym = std::min(y_max, th);
             for (int y = cy * CHUNK_LEN; y < ym; ++y)
             {
                 if (y >= th - 1)
-                { // 覆草【应当在挖空的逻辑之后做！】
-                    create_block(glm::ivec3(x, y, z), BLOCK_GRASS, true, chunk);
+                { // 按群系覆盖地表【应当在挖空的逻辑之后做！】
+                    BLOCK_ENUM surface = get_biome_surface_block(get_biome(sample_climate(x, z)));
+                    create_block(glm::ivec3(x, y, z), surface, true, chunk);
                     break;
                 }
                 create_block(glm::ivec3(x, y, z), BLOCK_DIRT, false, chunk);
@@ -468,12 +575,6 @@ static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing)
         }
     }
 
-    // 该位置没有建筑冲突，就尝试生成模型导入的建筑，每个区块至多一个建筑
-    if (GENERATE_BUILDING && !chunk->built)
-    {
-        generate_town(x_min, z_min, 50, 30);
-    }
-
     // 基岩铺底
     if (cy == 0)
     {
@@ -496,6 +597,36 @@ static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing)
             }
         }
     }
+}
+
+// 首次创建区块并填充方块（优先读取预生成的区块文件）
+static Chunk *generate_chunk(int cx, int cy, int cz, bool constructing)
+{
+    if (cx < 0 || cy < 0 || cz < 0)
+        return nullptr;
+    Chunk *chunk = get_chunk(cx, cy, cz);
+    if (chunk)
+    {
+        if (constructing)
+        {                        // 自然用地划为建筑用地
+            chunk->built = true; // 配合建完
+        }
+        return chunk; // 如果已经有区块，则返回
+    }
+
+    // 创建区块，新建的地事先声明用作建筑用地
+    chunk = set_chunk(cx, cy, cz, new Chunk(cx, cy, cz, constructing));
+
+    if (LOAD_CHUNK_STORE && load_chunk(chunk))
+        return chunk; // 预生成过的区块已经包含全部方块
+
+    fill_chunk(chunk);
+
+    // 该位置没有建筑冲突，就尝试生成模型导入的建筑，每个区块至多一个建筑
+    if (GENERATE_BUILDING && !chunk->built)
+    {
+        generate_town(cx * CHUNK_LEN, cz * CHUNK_LEN, 50, 30);
+    }
 
     return chunk;
 }
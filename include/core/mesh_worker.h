@@ -0,0 +1,51 @@
+// 后台区块网格化：主线程拍下区块快照并投递任务，工作线程生成CPU侧顶点，主线程每帧取回结果再上传显存，互不等待
+
+#ifndef MESH_WORKER_H
+#define MESH_WORKER_H
+
+#include <chunk_mesher.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// 一个网格化完成的区块，version与投递时的Chunk::mesh_version不同说明区块在此期间又被修改或取消渲染，结果作废
+struct MeshedChunk
+{
+    Chunk *chunk;
+    unsigned version;
+    Mesh *mesh;             // 不透明部分，没有可见面时为空
+    Mesh *translucent_mesh; // 透明方块部分，没有时为空
+};
+
+class ChunkMeshWorkers
+{
+private:
+    struct Job
+    {
+        Chunk *chunk;
+        unsigned version;
+        ChunkSnapshot snapshot;
+    };
+
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _job_ready;
+    std::deque<Job *> _jobs;
+    std::vector<MeshedChunk> _done; // 工作线程写入，主线程取走时整体交换
+    bool _stopping = false;
+
+    void run();
+
+public:
+    void start(int thread_count);
+    void stop(); // 丢弃未开始的任务和未取走的结果，等待工作线程退出
+    bool running() const { return !_threads.empty(); }
+
+    // 在主线程调用：拍下区块快照并投递，细节层次按到lod_center的距离决定
+    void submit(Chunk *chunk, glm::ivec3 lod_center);
+    // 在主线程调用：取走所有已完成的结果（与工作线程的结果列表交换，不拷贝）
+    void collect(std::vector<MeshedChunk> &results);
+};
+
+#endif /* MESH_WORKER_H */
@@ -4,6 +4,8 @@
 #define RENDER_SYSTEM_H
 
 #include <level_system.h>
+#include <chunk_mesher.h>
+#include <mesh_worker.h>
 #include <unordered_map>
 #include <vk_types.h>
 #include <player.h>
@@ -11,40 +13,36 @@
 static const int CHUNK_RENDER_RADIUS = 3;       // 渲染玩家附近多少区块
 static const int CHUNK_GEN_RADIUS = 4;          // 创建世界时渲染玩家附近多少区块
 static const int CHUNK_RENDER_COUNT_MAX = 2e2;  // 区块最大渲染数量
-static const int REFRESH_RENDER_FACE_MAX = 1e5; // 触发全局刷新的最大渲染面数
+static const int MESH_WORKER_COUNT = 2;         // 后台网格化线程数，0时在主线程网格化
+static const float TRANSLUCENT_RESORT_DISTANCE = 1.f; // 相机移动超过该距离（方块）才重新排序半透明网格
+static const int RENDERABLE_COMPACT_MIN = 1024; // 空闲槽位超过该数量且超过一半时压缩__renderables
+static const int CHUNK_REMESH_PER_FRAME = 8;    // 每帧最多重建多少个区块网格，其余留到之后的帧
 static const int TEXTURE_SIZE = 16;             // 正方形材质包边长
-static const int FACE_F = 0, FACE_R = 1, FACE_U = 2, FACE_D = 3, FACE_L = 4, FACE_B = 5;                     // 方块的六个面对应的索引
-static const glm::vec3 FACE_NORMALS[6]{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {0, 1, 0}}; // 方块的六个面对应的法线
+#define CHUNK_MESHING true                      // 每个区块合并成一个网格绘制，false时退回逐面渲染
 
 // default array of renderable objects
 extern std::vector<RenderObject> __renderables;
+// 槽位分配：__renderable_owners[i]指向记录槽位i的索引（Block::face_id或Chunk::mesh_id），空闲槽位为nullptr并记录在__free_renderables中
+extern std::vector<int *> __renderable_owners;
+extern std::vector<int> __free_renderables;
+extern std::vector<int> __dirty_renderables; // 内容改变（新放入、原地替换或压缩时移动）的槽位，可能重复，由VenomApp每帧取走并只上传这些槽位
 extern std::vector<Chunk *> __rendered_chunks; // 已渲染的区块列表
 // 每个可渲染对象所需的材质和网格来自于下列属性
 extern std::unordered_map<std::string, Material> __materials;
-extern std::vector<Mesh> __meshes; // 第一格为空【GPU会吞掉第一格的贴图，原因未知】
+extern Mesh __face_mesh; // 逐面渲染共用的单位正方形网格，贴图由RenderObject::tile决定
+// 区块网格的生命周期：网格化后进入__pending_meshes等待上传，被替换或取消渲染后进入__retired_meshes，由VenomApp在GPU不再使用时释放
+extern std::vector<Mesh *> __pending_meshes;
+extern std::vector<Mesh *> __retired_meshes;
+extern std::vector<Mesh *> __resorted_meshes; // 已上传、重新排序后需要上传新索引的半透明网格
+extern std::vector<Chunk *> __dirty_chunks; // 方块变化后需要重新网格化的区块
+extern ChunkMeshWorkers __mesh_workers;     // 进入渲染范围的区块在后台网格化
+extern glm::ivec3 __lod_center;             // 细节层次的中心区块（玩家所在区块），远处区块按chunk_lod_scale合并方块网格化
+extern bool __gpu_culling;                  // 是否用计算着色器剔除不透明物体（初始为GPU_CULLING，调试时按↑键切换）
 
 class RenderSystem
 {
 private:
-    // 以下属性用来将面组装成一个Block，遵循面顺序： FRUDLB
-    const glm::vec3 BLOCK_TRANSLATE_DIST[6] = {
-        glm::vec3(0, 0, 0),
-        glm::vec3(0, 0, 1),
-        glm::vec3(0, 1, 0),
-        glm::vec3(0, 0, 1),
-        glm::vec3(1, 0, 0),
-        glm::vec3(1, 0, 1),
-    }; // 六个面的平移距离
-
-    const glm::mat4 BLOCK_ROTATION[6] = {
-        glm::rotate(glm::mat4{1.0}, glm::radians(0.0f), glm::vec3(1, 0, 0)),
-        glm::rotate(glm::mat4{1.0}, glm::radians(90.0f), glm::vec3(0, 1, 0)),
-        glm::rotate(glm::mat4{1.0}, glm::radians(90.0f), glm::vec3(1, 0, 0)),
-        glm::rotate(glm::mat4{1.0}, glm::radians(-90.0f), glm::vec3(1, 0, 0)),
-        glm::rotate(glm::mat4{1.0}, glm::radians(-90.0f), glm::vec3(0, 1, 0)),
-        glm::rotate(glm::mat4{1.0}, glm::radians(180.0f), glm::vec3(0, 1, 0)),
-    }; // 六个面旋转方式
-
+    // 面顺序： FRUDLB，面的平移和旋转由texture.vert按面索引重建
     const glm::ivec3 BLOCK_DIR[6] = {
         glm::ivec3(0, 0, -1), // F
         glm::ivec3(-1, 0, 0), // R
@@ -55,17 +53,30 @@ private:
     }; // 相对Block的六个面的相邻单位向量
 public:
     Material *DEFAULT_MATERIAL;
+    Material *CHUNK_MATERIAL;
+    Material *CHUNK_TRANSLUCENT_MATERIAL;
 
     Material *create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name);
     Material *get_material(const std::string &name);
-    Mesh *get_mesh(BLOCK_ENUM block_kind);
     void init_scene();
+    void add_renderable(const RenderObject &object, int *owner);
+    void remove_renderable(int *owner);
+    void compact_renderables();
     void render_face(Block *block, int i);
     void unrender_face(Block *block, int i);
     void render_block(Block *block);
     void unrender_block(glm::ivec3 pos);
     void render_chunk(int rx, int ry, int rz);
     void unrender_chunk(Chunk *chunk);
+    void mesh_chunk(Chunk *chunk);
+    void request_chunk_mesh(Chunk *chunk);
+    void install_chunk_mesh(Chunk *chunk, Mesh *mesh, Mesh *translucent_mesh);
+    void place_chunk_mesh(Chunk *chunk, Mesh *&slot_mesh, int &slot_id, Mesh *mesh, Material *material);
+    void apply_meshed_chunks();
+    void sort_translucent_chunks(glm::vec3 camera_pos);
+    void mark_block_dirty(glm::ivec3 pos);
+    void update_dirty_chunks(glm::vec3 player_pos);
+    void update_chunk_lods(glm::ivec3 center);
     void render_all_chunks(glm::vec3 player_pos, bool rerender);
     void update_render_chunks(glm::ivec3 chunk_pos, glm::vec3 player_pos);
 };
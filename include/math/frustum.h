@@ -0,0 +1,38 @@
+// 视锥剔除：从相机的VP矩阵提取六个裁剪平面，轴对齐包围盒按结构数组存放，每4个一批用SIMD同时对一个平面求值
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+static const int FRUSTUM_BATCH = 4; // 每批测试的包围盒数（一个128位寄存器）
+
+// 六个平面（左右下上近远），法线指向视锥内部，dot(xyz, p) + w >= 0的点在平面内侧，未归一化
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// 按行组合proj * view提取平面（Gribb-Hartmann）；近平面取z >= -w，裁剪空间深度为[0, w]时也是保守的
+Frustum extract_frustum(const glm::mat4 &view_proj);
+
+// 一组待测试的包围盒，各分量分开连续存放并补齐到FRUSTUM_BATCH的整数倍
+class AABBBatch
+{
+private:
+    std::vector<float> _min[3], _max[3];
+    size_t _size = 0;
+
+public:
+    void clear();
+    void push(glm::vec3 min, glm::vec3 max);
+    size_t size() const { return _size; }
+
+    // visible[i]为1表示第i个包围盒与视锥相交或在其内部：对每个平面取包围盒在法线方向最远的角点，
+    // 它在平面外侧则整个包围盒都在外侧；返回可见的个数
+    size_t cull(const Frustum &frustum, std::vector<uint8_t> &visible) const;
+};
+
+#endif /* FRUSTUM_H */
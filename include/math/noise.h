@@ -65,19 +65,24 @@ inline float fbm(const vec2 uv)
     return total;
 }
 
-inline float surflet(vec2 P, vec2 gridPoint)
+// gradient是格点gridPoint的梯度，即random2(gridPoint)，可由noise_cache.h的缓存提供
+inline float surflet(vec2 P, vec2 gridPoint, vec2 gradient)
 {
     float distX = abs(P.x - gridPoint.x);
     float distY = abs(P.y - gridPoint.y);
     float tX = 1 - 6 * pow(distX, 5.0) + 15 * pow(distX, 4.0) - 10 * pow(distX, 3.0);
     float tY = 1 - 6 * pow(distY, 5.0) + 15 * pow(distY, 4.0) - 10 * pow(distY, 3.0);
 
-    vec2 gradient = random2(gridPoint);
     vec2 diff = P - gridPoint;
     float height = dot(diff, gradient);
     return height * tX * tY;
 }
 
+inline float surflet(vec2 P, vec2 gridPoint)
+{
+    return surflet(P, gridPoint, random2(gridPoint));
+}
+
 inline float perlinNoise(vec2 uv)
 {
     vec2 uvXLYL = floor(uv);
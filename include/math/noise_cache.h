@@ -0,0 +1,189 @@
+// 二维噪声格点缓存：相邻的列、区块反复查询相同格点的哈希（柏林梯度、细胞特征点、值噪声），
+// 以块（Tile）为单位缓存格点哈希，LRU淘汰，所有列和区块共享
+
+#ifndef NOISE_CACHE_H
+#define NOISE_CACHE_H
+
+#include <noise.h>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+
+static const int NOISE_TILE_LEN = 32;           // 每个缓存块覆盖的格点边长
+static const size_t NOISE_TILE_CACHE_MAX = 256; // 最多缓存的块数，超出后淘汰最久未使用的块
+
+struct glm_ivec2_hash
+{
+    size_t operator()(const glm::ivec2 &v) const
+    {
+        return (std::hash<int>()(v.x) * 73856093) ^ (std::hash<int>()(v.y) * 19349669);
+    }
+};
+
+// FNV-1a，用于给世界生成参数计算指纹
+inline uint64_t fnv1a_hash(const void *data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+// 一块格点的哈希值，按需填充
+struct NoiseTile
+{
+    glm::ivec2 tile_pos;                                 // 块坐标（格点坐标 / NOISE_TILE_LEN）
+    vec2 gradients[NOISE_TILE_LEN][NOISE_TILE_LEN];      // random2(格点)：柏林噪声梯度与细胞噪声特征点共用
+    float values[NOISE_TILE_LEN][NOISE_TILE_LEN];        // noise2D(格点)：fbm的值噪声
+    uint8_t ready[NOISE_TILE_LEN][NOISE_TILE_LEN];       // 低位表示gradients已填充，次低位表示values已填充
+};
+
+// 命中率统计
+struct NoiseCacheStats
+{
+    uint64_t hits = 0;       // 格点哈希直接取自缓存
+    uint64_t misses = 0;     // 格点哈希需要重新计算
+    uint64_t tile_loads = 0; // 新建的块数
+    uint64_t evictions = 0;  // 淘汰的块数
+
+    double hit_rate() const { return hits + misses ? (double)hits / (hits + misses) : 0.0; }
+};
+
+class NoiseTileCache
+{
+private:
+    std::list<NoiseTile> _tiles; // 表头是最近使用的块
+    std::unordered_map<glm::ivec2, std::list<NoiseTile>::iterator, glm_ivec2_hash> _index;
+    NoiseTile *_last = nullptr; // 上次访问的块，绝大多数查询落在同一块内
+
+    NoiseTile *find_tile(glm::ivec2 tile_pos);
+
+    // 向下取整的除法，格点坐标可能为负
+    static inline int floor_div(int a) { return a >= 0 ? a / NOISE_TILE_LEN : (a - NOISE_TILE_LEN + 1) / NOISE_TILE_LEN; }
+
+    inline NoiseTile *get_tile(int x, int y)
+    {
+        glm::ivec2 tile_pos(floor_div(x), floor_div(y));
+        if (_last && _last->tile_pos == tile_pos)
+            return _last;
+        return _last = find_tile(tile_pos);
+    }
+
+public:
+    NoiseCacheStats stats;
+
+    // 格点(x, y)的random2
+    inline vec2 gradient(int x, int y)
+    {
+        NoiseTile *tile = get_tile(x, y);
+        int i = x - tile->tile_pos.x * NOISE_TILE_LEN, j = y - tile->tile_pos.y * NOISE_TILE_LEN;
+        if (tile->ready[i][j] & 1)
+        {
+            ++stats.hits;
+            return tile->gradients[i][j];
+        }
+        ++stats.misses;
+        tile->ready[i][j] |= 1;
+        return tile->gradients[i][j] = random2(vec2(x, y));
+    }
+
+    // 格点(x, y)的noise2D
+    inline float value(int x, int y)
+    {
+        NoiseTile *tile = get_tile(x, y);
+        int i = x - tile->tile_pos.x * NOISE_TILE_LEN, j = y - tile->tile_pos.y * NOISE_TILE_LEN;
+        if (tile->ready[i][j] & 2)
+        {
+            ++stats.hits;
+            return tile->values[i][j];
+        }
+        ++stats.misses;
+        tile->ready[i][j] |= 2;
+        return tile->values[i][j] = noise2D(vec2(x, y));
+    }
+
+    void clear();
+    void print_stats() const;
+};
+
+// 每个线程一份缓存，生成线程之间无需加锁
+NoiseTileCache &noise_tile_cache();
+
+// 以下是noise.h中对应函数的缓存版本，结果逐位相同
+
+inline float perlinNoiseCached(vec2 uv)
+{
+    NoiseTileCache &cache = noise_tile_cache();
+    vec2 uvXLYL = floor(uv);
+    int x = int(uvXLYL.x), y = int(uvXLYL.y);
+    vec2 uvXHYL = uvXLYL + vec2(1, 0);
+    vec2 uvXHYH = uvXLYL + vec2(1, 1);
+    vec2 uvXLYH = uvXLYL + vec2(0, 1);
+
+    return surflet(uv, uvXLYL, cache.gradient(x, y)) + surflet(uv, uvXHYL, cache.gradient(x + 1, y)) +
+           surflet(uv, uvXHYH, cache.gradient(x + 1, y + 1)) + surflet(uv, uvXLYH, cache.gradient(x, y + 1));
+}
+
+inline float worleyNoiseCached(vec2 uv)
+{
+    NoiseTileCache &cache = noise_tile_cache();
+    vec2 uvInt = floor(uv);
+    vec2 uvFract = fract(uv);
+    int ix = int(uvInt.x), iy = int(uvInt.y);
+    float minDist = 1.0;
+
+    for (int y = -1; y <= 1; y++)
+    {
+        for (int x = -1; x <= 1; x++)
+        {
+            vec2 neighbor = vec2(float(x), float(y));
+
+            vec2 point = cache.gradient(ix + x, iy + y);
+
+            vec2 diff = neighbor + point - uvFract;
+            float dist = length(diff);
+            minDist = glm::min(minDist, dist);
+        }
+    }
+    return minDist;
+}
+
+inline float interpNoise2DCached(NoiseTileCache &cache, float x, float y)
+{
+    int intX = int(floor(x));
+    float fractX = glm::fract(x);
+
+    int intY = int(floor(y));
+    float fractY = fract(y);
+
+    float v1 = cache.value(intX, intY);
+    float v2 = cache.value(intX + 1, intY);
+    float v3 = cache.value(intX, intY + 1);
+    float v4 = cache.value(intX + 1, intY + 1);
+
+    float i1 = smoothing(v1, v2, fractX);
+    float i2 = smoothing(v3, v4, fractX);
+
+    return smoothing(i1, i2, fractY);
+}
+
+inline float fbmCached(const vec2 uv)
+{
+    NoiseTileCache &cache = noise_tile_cache();
+    float total = 0;
+    float persistence = 0.5f;
+    int octaves = 6;
+    float freq = 4.f;
+    float amp = 0.5f;
+
+    for (int i = 1; i <= octaves; i++)
+    {
+        total += interpNoise2DCached(cache, uv.x * freq, uv.y * freq) * amp;
+
+        freq *= 2.f;
+        amp *= persistence;
+    }
+    return total;
+}
+
+#endif /* NOISE_CACHE_H */
@@ -0,0 +1,86 @@
+// 声明式噪声图：地形由噪声节点和算术节点组成的有向无环图描述，可在代码中搭建或从文本文件读取。
+// 建图时做公共子表达式消除和常量折叠，求值时只计算输出可达的节点，并按批（整块区块的所有列）逐节点计算，
+// 算术节点和噪声节点都用SSE每次计算4列（噪声节点的格点哈希仍逐列从缓存读取），噪声节点与标量实现在容差内一致
+
+#ifndef NOISE_GRAPH_H
+#define NOISE_GRAPH_H
+
+#include <noise_cache.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+
+enum NOISE_OP
+{
+    NOISE_CONST,  // 常量
+    NOISE_INPUT,  // 外部输入（例如气候图插值结果），每列一个值
+    NOISE_ADD,    // a + b
+    NOISE_SUB,    // a - b
+    NOISE_MUL,    // a * b
+    NOISE_DIV,    // a / b
+    NOISE_POW,    // pow(a, b)
+    NOISE_ABS,    // abs(a)
+    NOISE_PERLIN, // perlinNoise((xz + offset) / divisor)
+    NOISE_WORLEY, // worleyNoise((xz + offset) / divisor)
+    NOISE_FBM     // fbm((xz + offset) / divisor)
+};
+
+struct NoiseNode
+{
+    NOISE_OP op;
+    int a = -1, b = -1;        // 操作数节点
+    float value = 0;           // 常量值，或输入通道号
+    glm::vec2 offset{0};       // 噪声采样偏移
+    float divisor = 1;         // 噪声采样缩放（除数）
+};
+
+class NoiseGraph
+{
+private:
+    std::vector<NoiseNode> _nodes;
+    std::map<std::tuple<int, int, int, float, float, float, float>, int> _node_ids; // 节点内容 -> 节点编号，用于公共子表达式消除
+    std::vector<std::string> _input_names;
+    std::map<std::string, int> _named; // 文件中的节点名
+    int _output = -1;
+    std::vector<int> _program; // 输出可达节点的求值顺序
+
+    int make_node(const NoiseNode &node);
+    int fold(NOISE_OP op, int a, int b);
+    bool is_const(int id, float value) const { return _nodes[id].op == NOISE_CONST && _nodes[id].value == value; }
+
+public:
+    static const int BATCH_MAX = 256; // 单次求值的最多列数
+
+    int constant(float value);
+    int input(const std::string &name);
+    int add(int a, int b) { return fold(NOISE_ADD, a, b); }
+    int sub(int a, int b) { return fold(NOISE_SUB, a, b); }
+    int mul(int a, int b) { return fold(NOISE_MUL, a, b); }
+    int div(int a, int b) { return fold(NOISE_DIV, a, b); }
+    int pow(int a, int b) { return fold(NOISE_POW, a, b); }
+    int abs(int a) { return fold(NOISE_ABS, a, -1); }
+    int perlin(glm::vec2 offset, float divisor);
+    int worley(glm::vec2 offset, float divisor);
+    int fbm(glm::vec2 offset, float divisor);
+
+    // 指定输出节点，并生成求值顺序（死节点不会被求值）
+    void set_output(int node);
+
+    // 输入通道号，evaluate的inputs按该顺序传入
+    int input_slot(const std::string &name) const;
+    const std::vector<std::string> &input_names() const { return _input_names; }
+    size_t node_count() const { return _nodes.size(); }
+    size_t program_size() const { return _program.size(); }
+    // 输入通道和输出可达节点的哈希，图变化后预生成的区块即失效
+    uint64_t fingerprint() const;
+
+    // 从文本文件读取，每行形如"名字 = 运算 参数..."，参数是之前定义的名字或数值，最后以"output 名字"指定输出；
+    // 噪声运算的参数是"offset_x offset_z divisor"（divisor须为正数），输入写作"名字 = input"，#开头为注释
+    bool load_from_file(const std::string &path);
+
+    // 批量求值n（<= BATCH_MAX）列，inputs[i]为第i个输入通道的n个值
+    void evaluate(const glm::vec2 *xz, int n, const float *const *inputs, float *out) const;
+};
+
+#endif /* NOISE_GRAPH_H */
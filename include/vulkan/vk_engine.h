@@ -3,8 +3,13 @@
 
 #define SHADER_DIR "./assets/shaders/"
 #define TEXTURE_DIR "./assets/textures/"
+#define PIPELINE_CACHE_FILE "./pipeline_cache.bin" // 管线缓存，退出时写入，下次启动时由驱动复用已编译的着色器
 
 #include <vk_init.h>
+#include <vk_range_allocator.h>
+#include <vk_record_workers.h>
+#include <vk_upload.h>
+#include <frustum.h>
 #include <physics_system.h>
 #include <input_system.h>
 #include <cmath>
@@ -47,15 +52,19 @@ inline void tik(uint32_t current_frame)
     frame_start = current_frame;
 }
 static const float FPS_CHECK_PERIOD = 1; // 检测间隔（单位：秒）
-inline void tok(uint32_t current_frame)
+static const bool FRAME_STATS_LOG = false; // 为true时每个检测间隔把帧率和渲染统计也输出到控制台（无窗口标题的软件渲染环境下也能观察）
+// stats为最近一帧的渲染统计，与帧率一起显示
+inline void tok(uint32_t current_frame, const string &stats)
 {
     clock_late = std::chrono::high_resolution_clock::now();
     double elapse_sec = (double)(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_late - clock_early).count()) / 1e9;
     if (elapse_sec >= FPS_CHECK_PERIOD)
     {
         clock_early = clock_late;
-        string title = WINDOW_TITLE + string(" FPS: ") + to_string(current_frame - frame_start);
+        string title = WINDOW_TITLE + string(" FPS: ") + to_string(current_frame - frame_start) + " " + stats;
         glfwSetWindowTitle(__window, title.c_str());
+        if (FRAME_STATS_LOG)
+            cout << title << endl;
         frame_start = current_frame;
     }
 }
@@ -80,23 +89,26 @@ inline void tok(uint32_t current_frame)
 // VK_FILTER_NEAREST，取最近点像素，最快
 // VK_FILTER_LINEAR，取附近两个点做线性插值
 #define VK_SHADOW_FILTER_MODE VK_FILTER_LINEAR
+// 片元着色器是否采样阴影贴图，低端机器可关闭，区块网格顶点中烘焙的环境光遮蔽仍然提供深度感
+#define SHADOW_MAP_SAMPLING true
+// 设备支持multiDrawIndirect时，把每帧的绘制命令写入间接绘制缓冲，共用顶点/索引缓冲的物体合并成一次vkCmdDrawIndexedIndirect
+#define INDIRECT_DRAW true
+// 录制绘制命令前按相机视锥剔除物体（区块网格按区块、逐面渲染按方块的包围盒），完全在视锥外的物体不提交
+#define FRUSTUM_CULLING true
+// 间接绘制开启时，用计算着色器按视锥和上一帧深度生成的深度金字塔（Hi-Z）剔除不透明物体，通过的物体由GPU写入间接绘制命令；
+// 这里是初始状态，运行中按↑键切换（__gpu_culling），便于对比
+#define GPU_CULLING true
 
 using namespace std;
 
-// 报错即终止
-#define VK_CHECK(x)                                                     \
-    do                                                                  \
-    {                                                                   \
-        VkResult err = x;                                               \
-        if (err)                                                        \
-        {                                                               \
-            std::cout << "Detected Vulkan error: " << err << std::endl; \
-            abort();                                                    \
-        }                                                               \
-    } while (0)
-
 const int MAX_FRAMES_IN_FLIGHT = 3; // 一次性加载的帧数（不会因为渲染当前帧而打扰下一帧的录入，建议与_swapchain_images.size()保持一致）
 const int UNIFORM_BUFFERS_CNT = 10;
+const uint32_t CHUNK_VERTEX_POOL_SIZE = 1 << 22; // 区块顶点池容量（顶点数，每个ChunkVertex 8字节），放不下的网格退回独立的顶点缓冲
+const int DEPTH_PYRAMID_MAX_LEVELS = 16; // 深度金字塔最多的层数（第0层边长不超过2^15）
+const uint32_t CULL_GROUP_SIZE = 64; // 与cull.comp中的local_size_x一致
+const int RECORD_WORKER_COUNT = 2; // 录制绘制命令的工作线程数，0时在主线程直接录制到主命令缓冲
+const int RECORD_PARALLEL_MIN_ITEMS = 64; // 绘制项少于该数量时仍在主线程录制（分发和执行二级命令缓冲的开销比录制本身大）
+const uint64_t UPLOAD_RING_SIZE = 32 << 20; // 上传用暂存环形缓冲的字节数，写满时CPU等待最旧的一批复制完成
 const int MAX_OBJECTS = 1e6; // 每帧最大渲染物体数量，虚幻引擎采用动态扩展上限技术（场景物体越多，该数值越大）
 // 目前的代码逻辑下，如果该数值少于场景内物体数量且开启多重缓冲，则会发生屏闪（猜测是因为每次缓冲的对象集合有所不同）；如果缓冲数为1，则渲染的网格关系错乱（猜测是丢失了一些顶点数据）
 
@@ -144,6 +156,8 @@ private:
     VkDevice _device; // 逻辑设备，注意和实例没有直接关联！
     VkQueue _graphics_queue;
     uint32_t _graphics_queue_family; // 图形队列簇（记录的是索引！）
+    VkQueue _upload_queue;           // 上传网格和纹理的队列，设备有专用传输队列时使用它，否则与图形队列相同
+    uint32_t _upload_queue_family;
 
     VkSurfaceKHR _surface; // 调用窗口渲染，离屏渲染可以不使用
 
@@ -178,22 +192,70 @@ private:
     GPUSceneData _scene_parameters;
     AllocatedBuffer _scene_parameter_buffer;
 
-    UploadContext _upload_context;
+    UploadContext _upload_context; // 只用于初始化时的图像布局转换
+    UploadManager _uploader;       // 网格和纹理的异步上传
 
     unordered_map<string, Texture> _loaded_textures; // 图形渲染管线及其布局藏在这！
     std::string _default_material_name = "textured"; // 默认材质的名称
+    std::string _chunk_material_name = "chunk";      // 区块合并网格的材质名称
+    std::string _chunk_translucent_material_name = "chunk_translucent"; // 区块中透明方块的材质名称
+
+    AllocatedBuffer _static_geometry; // 启动时一次上传的静态几何：开头是共享的四边形索引（QUAD_INDEX_PATTERN重复MESH_QUAD_MAX次），之后是各常驻网格的顶点
+    AllocatedBuffer _chunk_vertex_pool;  // 不透明区块网格共用的顶点缓冲，各网格按_pool_offset区分，间接绘制时一次绑定画完所有区块
+    RangeAllocator _chunk_vertex_ranges; // 以顶点为单位分配_chunk_vertex_pool
+    bool _indirect_draw = false;         // INDIRECT_DRAW开启且设备支持multiDrawIndirect和drawIndirectFirstInstance
+    // 最近一帧draw_objects录制的统计，用于对比直接绘制和间接绘制
+    struct FrameStats
+    {
+        uint32_t objects = 0;  // 提交绘制的物体数
+        uint32_t culled = 0;   // 被视锥剔除的物体数
+        uint32_t draws = 0;    // 绘制命令数（vkCmdDrawIndexed / vkCmdDrawIndexedIndirect）
+        uint32_t commands = 0; // 录制的全部命令数（绑定管线、描述符集、缓冲和绘制）
+        size_t upload_bytes = 0; // CPU写入显存可见内存的字节数（物体/场景/相机/实例/间接绘制缓冲和网格暂存缓冲）
+        uint32_t gpu_culled = 0; // 被GPU剔除的物体数（结果回读有延迟，是MAX_FRAMES_IN_FLIGHT帧之前提交的那一帧）
+    } _frame_stats;
+    // 一次绘制调用，prepare_draws按绘制顺序生成，draw_objects录制；多线程录制时按区间分给各个线程
+    struct DrawItem
+    {
+        Material *material;
+        const Mesh *mesh;
+        uint32_t first;  // 间接绘制时为第一条命令的序号，否则为实例缓冲中的起点
+        uint32_t count;  // 间接绘制时为命令数，否则为实例数
+        bool indirect;
+    };
+    vector<DrawItem> _draw_items; // 不透明物体在前，半透明物体（每个区块一项，从远到近）在后
+    glm::mat4 _view_proj;         // 本帧相机的VP矩阵
+    RecordWorkers _record_workers;
+    // 持久映射缓冲中各区域上次写入的内容，相同则跳过写入
+    std::optional<GPUSceneData> _uploaded_scene[MAX_FRAMES_IN_FLIGHT];
+    std::optional<GPUCameraData> _uploaded_camera[MAX_FRAMES_IN_FLIGHT];
+    std::optional<GPULightSpaceData> _uploaded_light_space;
+    deque<pair<uint32_t, Mesh *>> _retired_chunk_meshes; // 等待释放的区块网格及其被替换时的帧号
+    deque<pair<uint32_t, AllocatedBuffer>> _retired_buffers; // 等待释放的缓冲（半透明网格重新排序前的索引）及其被替换时的帧号
 
     bool _resize_requested = false; // 窗口大小重置
 
+    VkPipelineCache _pipeline_cache;  // 所有管线共用，从PIPELINE_CACHE_FILE加载
+    bool _pipeline_cache_loaded = false; // 本次启动读到了有效的缓存文件
+    std::chrono::high_resolution_clock::duration _pipeline_build_time{}; // 启动时创建管线的总耗时
+
     void resize_swapchain();
     void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
     size_t pad_uniform_buffer_size(size_t originalSize);
-    AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+    AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool mapped = false);
+    void write_mapped(const AllocatedBuffer &buffer, size_t offset, const void *src, size_t size);
+    template <typename T>
+    void write_mapped_if_changed(const AllocatedBuffer &buffer, size_t offset, const T &value, std::optional<T> &uploaded);
     FrameData &get_current_frame();
     void load_texture();
     void load_meshes();
     bool load_from_image(const char *file, AllocatedImage &outImage);
-    void upload_mesh(Mesh &mesh);
+    AllocatedBuffer upload_buffer(const void *src, size_t bufferSize, VkBufferUsageFlags usage);
+    void upload_chunk_meshes();
+    void release_chunk_meshes(bool all);
+    void destroy_chunk_mesh_buffers(Mesh *mesh);
+    VkBuffer mesh_vertex_buffer(const Mesh *mesh) const;
+    VkBuffer mesh_index_buffer(const Mesh *mesh) const;
     static void framebufferResizeCallback(GLFWwindow *window, int width, int height)
     {                                                                              // 更新FrameBuffer尺寸时的回调
         auto app = reinterpret_cast<VenomApp *>(glfwGetWindowUserPointer(window)); // 抓取伪指针
@@ -201,8 +263,10 @@ private:
     }
     void initWindow();
     bool load_shader_module(const string &filePath, VkShaderModule *outShaderModule);
-    void init_pipelines(const string &shader_vert_path, const string &shader_frag_path);
+    void init_pipelines(const string &shader_vert_path, const string &shader_frag_path, const string &material_name, const VertexInputDescription &vertexDescription, bool translucent = false);
     void init_device_allocator_queue(vkb::Instance &vkb_inst);
+    void init_pipeline_cache();
+    void save_pipeline_cache();
     void init_swapchain();
     void init_depth_image();
     void init_command_pool_and_queue();
@@ -214,7 +278,9 @@ private:
     void init_descriptor_sets();
     void initVulkan();
     void update_render_resource(FrameData &current_frame);
-    void draw_objects(VkCommandBuffer cmd, FrameData &current_frame);
+    void prepare_draws(FrameData &current_frame);
+    void draw_objects(VkCommandBuffer cmd, FrameData &current_frame, size_t begin, size_t end, FrameStats &stats);
+    void draw_objects_parallel(VkCommandBuffer cmd, FrameData &current_frame, VkFramebuffer framebuffer);
     void drawcall();
     void mainLoop();
     void cleanup();
@@ -230,6 +296,26 @@ private:
     void init_shadow_render_pass();
     void init_shadow_framebuffer();
     void init_shadow_pipeline();
+
+    // GPU剔除功能（深度金字塔由每帧RenderPass之后的深度图生成，下一帧RenderPass之前用于剔除）
+
+    AllocatedImage _depth_pyramid; // R32F，每层的texel为上一层对应区域的最大深度，始终处于GENERAL布局
+    uint32_t _depth_pyramid_levels;
+    VkImageView _depth_pyramid_views[DEPTH_PYRAMID_MAX_LEVELS]; // 单层视图：生成时作为存储图像写入，再作为下一层的源
+    VkDescriptorSet _depth_pyramid_sets[DEPTH_PYRAMID_MAX_LEVELS]; // 生成每一层用的描述符集（源、目标）
+    VkDescriptorSetLayout _depth_pyramid_set_layout;
+    VkDescriptorSetLayout _cull_set_layout;
+    VkPipelineLayout _depth_pyramid_pipeline_layout;
+    VkPipelineLayout _cull_pipeline_layout;
+    VkPipeline _depth_pyramid_pipeline;
+    VkPipeline _cull_pipeline;
+    bool _gpu_culling_frame = false;    // 本帧是否使用GPU剔除（__gpu_culling且支持间接绘制）
+    bool _depth_pyramid_ready = false;  // 上一帧生成了深度金字塔，否则本帧只做视锥测试
+    glm::mat4 _depth_pyramid_view_proj; // 生成深度金字塔那一帧的VP矩阵
+
+    void init_gpu_culling();
+    void dispatch_culling(VkCommandBuffer cmd, FrameData &current_frame);
+    void build_depth_pyramid(VkCommandBuffer cmd);
 };
 
 #endif // VK_ENGINE_H
\ No newline at end of file
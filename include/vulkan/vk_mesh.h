@@ -31,22 +31,54 @@ struct Vertex
     static VertexInputDescription get_vertex_description();
 };
 
+// 区块合并网格的压缩顶点（8字节，Vertex为44字节）：法线和面内坐标由面索引在chunk.vert中还原，不逐顶点存储
+// data.x：位置xyz各6位（区块内坐标）、面索引3位；data.y：贴图编号16位、亮度8位（255为不遮挡）
+struct ChunkVertex
+{
+    glm::uvec2 data; // Location 0
+
+    static ChunkVertex pack(glm::ivec3 position, int face, int tile, int light)
+    {
+        ChunkVertex vertex;
+        vertex.data.x = (uint32_t)position.x | (uint32_t)position.y << 6 | (uint32_t)position.z << 12 | (uint32_t)face << 18;
+        vertex.data.y = (uint32_t)tile | (uint32_t)light << 16;
+        return vertex;
+    }
+    static VertexInputDescription get_vertex_description();
+};
+
+// 所有方块网格都由四边形组成，每个四边形4个顶点（逆时针），按同一个索引模式拆成两个三角形，
+// 第q个四边形的索引为4q + QUAD_INDEX_PATTERN[i]；没有自己索引的网格共用VenomApp中按该模式生成的索引缓冲
+static const uint32_t QUAD_INDEX_PATTERN[6] = {0, 1, 2, 2, 3, 0};
+static const uint32_t MESH_NOT_POOLED = UINT32_MAX; // 网格使用自己的顶点缓冲，不在VenomApp的区块顶点池中
+static const uint32_t MESH_NOT_STATIC = UINT32_MAX; // 网格不在VenomApp的静态几何缓冲中
+
 struct Mesh
 {
     std::vector<Vertex> _vertices;
+    std::vector<ChunkVertex> _packed_vertices; // 区块合并网格使用压缩顶点，与_vertices二选一
     AllocatedBuffer _vertexBuffer;
+    uint32_t _pool_offset = MESH_NOT_POOLED; // 在区块顶点池中的起始顶点（绘制时作为vertexOffset），此时_vertexBuffer不使用
+    uint32_t _static_offset = MESH_NOT_STATIC; // 在静态几何缓冲中的起始顶点（同上），启动时加载的常驻网格使用
+    std::vector<uint32_t> _indices;       // 非空时使用自己的索引（半透明区块网格按从后往前的顺序排列四边形），否则使用共享的四边形索引
+    AllocatedBuffer _indexBuffer;
+    std::vector<glm::vec3> _quad_centers; // 半透明区块网格每个四边形的中心（区块内坐标），排序用
 
+    size_t vertex_count() const { return _vertices.size() + _packed_vertices.size(); }
+    size_t index_count() const { return _indices.empty() ? vertex_count() / 4 * 6 : _indices.size(); }
     bool load_from_obj(const char *filename);
 };
 
 static const float LIGHT_SCALE = 1 / 16.f; // 光强刻度
+static const int OBJECT_FACE_NONE = 6;     // 不旋转的物体（区块网格）的面索引
 struct RenderObject
 {
     Mesh *mesh;
     Material *material;
-    glm::mat4 model_transform;
+    glm::ivec3 pos;              // 世界坐标：逐面渲染为面所在的方块，区块网格为区块原点
+    int face = OBJECT_FACE_NONE; // 面索引（FRUDLB），着色器按它把单位面旋转平移到方块的对应面上
     glm::vec4 objectLight{0.f, 0.f, 0.f, LIGHT_SCALE}; //  物体自身光强，xyz为自身光照色彩，w所在格亮度（1.0满亮度）
-    glm::vec3 normal;
+    int tile = 0; // 贴图在材质包中的编号，逐面渲染时所有面共用一个单位面网格，由着色器按编号取贴图
 };
 
 #endif /* VK_MESH_H */
@@ -20,7 +20,7 @@ public:
     VkPipelineLayout _pipelineLayout;
     VkPipelineDepthStencilStateCreateInfo _depthStencil;
 
-    VkPipeline build(VkDevice device, VkRenderPass pass);
+    VkPipeline build(VkDevice device, VkRenderPass pass, VkPipelineCache cache = VK_NULL_HANDLE);
 };
 
 #endif  // VK_PIPELINE_BUILDER_H
\ No newline at end of file
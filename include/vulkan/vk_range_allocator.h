@@ -0,0 +1,26 @@
+// 在一段连续空间（如缓冲中的顶点）上分配子区间：首次适配，释放时与相邻的空闲区间合并
+
+#ifndef VK_RANGE_ALLOCATOR_H
+#define VK_RANGE_ALLOCATOR_H
+
+#include <cstdint>
+#include <map>
+
+class RangeAllocator
+{
+private:
+    std::map<uint32_t, uint32_t> _free; // 空闲区间：起点 -> 长度，按起点排序便于合并
+    uint32_t _capacity = 0;
+    uint32_t _used = 0;
+
+public:
+    static const uint32_t INVALID = UINT32_MAX; // 分配失败
+
+    void init(uint32_t capacity);
+    uint32_t allocate(uint32_t size);
+    void free(uint32_t offset, uint32_t size);
+    uint32_t used() const { return _used; }
+    uint32_t capacity() const { return _capacity; }
+};
+
+#endif /* VK_RANGE_ALLOCATOR_H */
@@ -0,0 +1,37 @@
+// 多线程录制命令：固定数量的工作线程，主线程每帧把录制任务分给所有线程并等待全部完成，
+// 每个线程只使用自己的命令池，录制到各自的二级命令缓冲，再由主命令缓冲在RenderPass内执行
+
+#ifndef VK_RECORD_WORKERS_H
+#define VK_RECORD_WORKERS_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class RecordWorkers
+{
+private:
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _task_ready, _task_done;
+    std::function<void(int)> _task; // 本轮任务，参数为工作线程下标，所有线程完成前不变
+    uint64_t _round = 0;            // 每分发一次加1，工作线程据此判断是否有新任务
+    int _pending = 0;               // 本轮还没完成的线程数
+    bool _stopping = false;
+
+    void run(int index);
+
+public:
+    void start(int thread_count);
+    void stop(); // 等待工作线程退出
+    bool running() const { return !_threads.empty(); }
+    int size() const { return (int)_threads.size(); }
+
+    // 在主线程调用：每个工作线程执行一次task(线程下标)，全部返回后才返回
+    void run_all(const std::function<void(int)> &task);
+};
+
+#endif /* VK_RECORD_WORKERS_H */
@@ -3,12 +3,28 @@
 #include <vulkan/vulkan.h>
 #include <vma/vk_mem_alloc.h>
 #include <glm/glm.hpp> //线性代数（向量、矩阵）
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+
+// 报错即终止
+#define VK_CHECK(x)                                                     \
+    do                                                                  \
+    {                                                                   \
+        VkResult err = x;                                               \
+        if (err)                                                        \
+        {                                                               \
+            std::cout << "Detected Vulkan error: " << err << std::endl; \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
 
 // 分配好的缓存
 struct AllocatedBuffer
 {
     VkBuffer _buffer;
     VmaAllocation _allocation; // 分配信息，如大小，分配的内存来源
+    void *_mapped = nullptr;   // 持久映射的CPU地址（create_buffer时要求映射），否则为空
 };
 
 // 分配好的图片
@@ -30,18 +46,32 @@ struct FrameData
 
     VkCommandPool _commandPool;
     VkCommandBuffer _mainCommandBuffer;
+    // 每个录制线程一个命令池和一个二级命令缓冲，只由该线程使用，每帧整池重置
+    std::vector<VkCommandPool> _recordPools;
+    std::vector<VkCommandBuffer> _recordCommandBuffers;
 
     AllocatedBuffer cameraBuffer;
     VkDescriptorSet globalDescriptorSet;
 
     AllocatedBuffer objectBuffer;
+    std::vector<uint32_t> dirtyObjects; // 自本帧objectBuffer上次写入以来内容改变的__renderables槽位，轮到本帧时只重写这些槽位
+    AllocatedBuffer instanceBuffer; // 实例序号 -> 物体在objectBuffer中的槽位，同一网格的物体连续存放，用一次实例化绘制画完
     VkDescriptorSet objectDescriptorSet;
+
+    AllocatedBuffer indirectBuffer; // 间接绘制命令（VkDrawIndexedIndirectCommand），每个物体最多一条
+
+    // GPU剔除：CPU只写入候选物体，计算着色器把通过测试的物体追加到所在命令的实例区间
+    AllocatedBuffer cullCandidateBuffer; // 候选物体（objectBuffer槽位，间接绘制命令序号）
+    AllocatedBuffer cullParamBuffer;     // GPUCullParams
+    AllocatedBuffer cullStatsBuffer;     // 通过剔除的物体数，帧栅栏等待后回读
+    VkDescriptorSet cullDescriptorSet;
+    uint32_t cullCandidates = 0; // 本帧上次提交的候选物体数，0表示没有做GPU剔除
 };
 
-// 内存到显存同步数据的专用数据结构
+// 初始化时一次性提交并等待完成的指令（图像布局转换），网格和纹理数据由UploadManager异步上传
 struct UploadContext
 {
-    VkFence _uploadFence; // 多个upload_mesh调用，要保证先后执行
+    VkFence _uploadFence; // immediate_submit提交后等待执行完成
     VkCommandPool _commandPool;
     VkCommandBuffer _commandBuffer;
 };
@@ -72,17 +102,27 @@ struct GPULightSpaceData
 struct GPUSceneData
 {
     glm::vec4 fogColor{0.5f, 1.f, 1.f, 0.f};    // w is for exponent
-    glm::vec4 fogDistance{16.f, 0.f, 2.f, 0.f}; // x for min, y for max, z 越大雾气扩大速度越慢, w unused.
+    glm::vec4 fogDistance{16.f, 0.f, 2.f, 0.f}; // x for min, y for max, z 越大雾气扩大速度越慢, w为1时片元着色器采样阴影贴图（SHADOW_MAP_SAMPLING）
     glm::vec4 ambientColor;
     glm::vec4 sunPos; // w for sun power
     glm::vec4 sunlightColor;
 };
 
+// 紧凑的物体记录（12字节），面的旋转只有固定的六种，着色器由整数位置和面索引重建变换，与着色器中的ObjectData（std430）一致
 struct GPUObjectData
 {
-    glm::mat4 modelMatrix;
-    glm::vec4 objectLight; // 物体自身光强，xyz为自身光照色彩，w所在格亮度（1.0满亮度）
-    glm::vec4 normal;      // 面的法向量
+    uint32_t xy;        // 世界坐标x、y（方块，各16位有符号）
+    uint32_t zFaceTile; // 世界坐标z（16位有符号）、面索引（8位，OBJECT_FACE_NONE不旋转）、贴图编号（8位）
+    uint32_t light;     // 物体自身光强RGB和所在格亮度，各8位（255对应1.0）
+};
+
+// GPU剔除的参数，与cull.comp中的CullParams（std140）一致
+struct GPUCullParams
+{
+    glm::vec4 planes[6];     // 当前相机的视锥平面（见frustum.h）
+    glm::mat4 prevViewProj;  // 生成深度金字塔那一帧的VP矩阵，遮挡测试把包围盒投影到那一帧的屏幕上
+    glm::ivec4 pyramid;      // xy为金字塔第0层尺寸，z为层数，w为1时金字塔有效
+    glm::uvec4 counts;       // x为候选物体数
 };
 
 // note that we store the VkPipeline and layout by value, not pointer.
@@ -92,6 +132,7 @@ struct Material
     VkDescriptorSet textureSet{VK_NULL_HANDLE}; // texture defaulted to null
     VkPipeline pipeline;
     VkPipelineLayout pipelineLayout;
+    bool translucent = false; // 不写深度，在所有不透明物体之后从后往前绘制
 };
 
 #endif /* VK_TYPES_H */
@@ -0,0 +1,65 @@
+// 异步上传：数据先写入持久映射的暂存环形缓冲，复制命令按帧合并成一批，提交到上传队列（设备有专用传输队列时使用它）后立即返回；
+// 每批提交时给时间线信号量赋一个递增的值，图形队列提交时等待最近一批的值，CPU只在暂存环空间不足时等待最旧的一批完成
+
+#ifndef VK_UPLOAD_H
+#define VK_UPLOAD_H
+
+#include <vk_types.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+class UploadManager
+{
+private:
+    // 一批复制命令，提交后等时间线信号量达到value时回收（重置命令池、释放暂存环空间）
+    struct Batch
+    {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        uint64_t value = 0;                // 提交时的时间线值
+        uint64_t ring_end = 0;             // 本批在暂存环中写到的位置（单调递增的字节计数）
+        std::vector<AllocatedBuffer> large; // 放不进暂存环的数据单独使用的暂存缓冲，批次完成后释放
+    };
+
+    VkDevice _device = VK_NULL_HANDLE;
+    VmaAllocator _allocator = VK_NULL_HANDLE;
+    VkQueue _queue = VK_NULL_HANDLE;
+    uint32_t _queue_family = 0;
+
+    AllocatedBuffer _ring;
+    uint64_t _ring_size = 0;
+    uint64_t _head = 0; // 下一次分配的起点（单调递增，对_ring_size取模得到缓冲内偏移）
+    uint64_t _tail = 0; // 之前的空间还可能被未完成的批次读取
+
+    Batch _recording;         // 正在录制的一批（cmd为空表示还没有开始）
+    std::deque<Batch> _in_flight; // 已提交、未回收的批次，按提交顺序
+    std::vector<Batch> _free;     // 已回收、可复用的批次
+
+    VkSemaphore _timeline = VK_NULL_HANDLE; // 设备不支持时间线信号量时为空，每批提交后同步等待上传队列空闲
+    PFN_vkWaitSemaphoresKHR _wait_semaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR _get_counter_value = nullptr;
+    uint64_t _submitted = 0; // 最近提交的一批的时间线值
+
+    AllocatedBuffer create_staging(uint64_t size);
+    VkCommandBuffer begin_batch();
+    char *allocate(uint64_t size, AllocatedBuffer &staging, VkDeviceSize &offset);
+    void reclaim(uint64_t completed);
+
+public:
+    void init(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queue_family, uint64_t ring_size, bool timeline);
+    void destroy(); // 等待全部批次完成后释放
+
+    // 复制src到dst的dst_offset处，命令记入当前批次，submit之后才执行
+    void copy_to_buffer(const void *src, size_t size, VkBuffer dst, VkDeviceSize dst_offset);
+    // 复制RGBA8像素到整个图像（第0层），并把图像转换到SHADER_READ_ONLY_OPTIMAL
+    void copy_to_image(const void *src, size_t size, VkImage dst, VkExtent3D extent);
+    // 提交当前批次，不等待执行完成；没有新的复制时什么也不做
+    void submit();
+    void wait(uint64_t value); // 阻塞到时间线值value对应的批次执行完成
+
+    VkSemaphore semaphore() const { return _timeline; }
+    uint64_t submitted() const { return _submitted; }
+};
+
+#endif /* VK_UPLOAD_H */
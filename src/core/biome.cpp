@@ -0,0 +1,110 @@
+#include "biome.h"
+#include <noise_cache.h>
+#include <spline.h>
+#include <cstring>
+#include <algorithm>
+
+static ClimateSample __climate_grid[BIOME_GRID_LEN][BIOME_GRID_LEN]; // 气候网格，第i行第j列对应世界坐标(i * BIOME_CELL, j * BIOME_CELL)
+static bool __climate_ready[BIOME_GRID_LEN][BIOME_GRID_LEN];          // 该网格点是否已经计算过
+
+void init_climate_map()
+{
+    memset(__climate_ready, 0, sizeof(__climate_ready));
+}
+
+// 在一个网格点上计算全部缓变场（原先每一列都要重复计算）
+static void compute_climate(int gx, int gz)
+{
+    glm::vec2 xz(gx * BIOME_CELL, gz * BIOME_CELL);
+    ClimateSample &climate = __climate_grid[gx][gz];
+
+    // 石头地基的三条样条共用同一个低频柏林噪声
+    float f = 0.015; // 越大地形变化越快
+    float noise = perlinNoiseCached(xz * f);
+    climate.continent = spline::continent(noise);
+    climate.erosion = spline::erosion(noise);
+    climate.peak_valley = spline::peak_valley(noise);
+
+    // Mountain vs plain mixing 混合权重生成
+    float a = 1, b = 0, c = 1, d = 1;
+    float n1 = worleyNoiseCached((xz + vec2(10)) / 200.0f);
+    float n2 = perlinNoiseCached((xz + vec2(1000)) / 300.0f);
+    n2 = 1 - abs(n2);
+    float n3 = fbmCached((xz) / 400.f);
+    float n4 = fbmCached((xz) / 200.f);
+    float mix = n1 * a + n2 * b + n3 * c + n4 * d;
+    mix = mix / (a + b + c + d);
+    float exp = worleyNoiseCached((xz + vec2(3000)) / 400.f);
+    climate.mix = 1 - pow(mix, 4 * exp);
+
+    // 山地的大尺度起伏
+    climate.ridge = worleyNoiseCached(vec2(xz / 200.f));
+
+    __climate_ready[gx][gz] = true;
+}
+
+static inline const ClimateSample &get_climate_point(int gx, int gz)
+{
+    if (!__climate_ready[gx][gz])
+        compute_climate(gx, gz);
+    return __climate_grid[gx][gz];
+}
+
+void prepare_climate_map(int x_min, int z_min, int x_max, int z_max)
+{
+    int gx_max = std::min(BIOME_GRID_LEN - 1, (x_max - 1) / BIOME_CELL + 1);
+    int gz_max = std::min(BIOME_GRID_LEN - 1, (z_max - 1) / BIOME_CELL + 1);
+    for (int gx = std::max(0, x_min / BIOME_CELL); gx <= gx_max; ++gx)
+        for (int gz = std::max(0, z_min / BIOME_CELL); gz <= gz_max; ++gz)
+            get_climate_point(gx, gz);
+}
+
+uint64_t climate_fingerprint()
+{
+    uint64_t hash = fnv1a_hash(&BIOME_CELL, sizeof(BIOME_CELL));
+    int probes[4] = {0, BIOME_GRID_LEN / 3, BIOME_GRID_LEN / 2, BIOME_GRID_LEN - 1};
+    for (int gx : probes)
+        for (int gz : probes)
+        {
+            const ClimateSample &climate = get_climate_point(gx, gz);
+            hash = fnv1a_hash(&climate, sizeof(climate), hash);
+        }
+    return hash;
+}
+
+ClimateSample sample_climate(int x, int z)
+{
+    int gx = std::min(x / BIOME_CELL, BIOME_GRID_LEN - 2), gz = std::min(z / BIOME_CELL, BIOME_GRID_LEN - 2); // 越界的列取最近的网格
+    float tx = (x % BIOME_CELL) / (float)BIOME_CELL;
+    float tz = (z % BIOME_CELL) / (float)BIOME_CELL;
+    // 双线性插值四个角的网格点
+    const ClimateSample &c00 = get_climate_point(gx, gz);
+    const ClimateSample &c10 = get_climate_point(gx + 1, gz);
+    const ClimateSample &c01 = get_climate_point(gx, gz + 1);
+    const ClimateSample &c11 = get_climate_point(gx + 1, gz + 1);
+    float w00 = (1 - tx) * (1 - tz), w10 = tx * (1 - tz), w01 = (1 - tx) * tz, w11 = tx * tz;
+
+    ClimateSample climate;
+    climate.continent = c00.continent * w00 + c10.continent * w10 + c01.continent * w01 + c11.continent * w11;
+    climate.erosion = c00.erosion * w00 + c10.erosion * w10 + c01.erosion * w01 + c11.erosion * w11;
+    climate.peak_valley = c00.peak_valley * w00 + c10.peak_valley * w10 + c01.peak_valley * w01 + c11.peak_valley * w11;
+    climate.mix = c00.mix * w00 + c10.mix * w10 + c01.mix * w01 + c11.mix * w11;
+    climate.ridge = c00.ridge * w00 + c10.ridge * w10 + c01.ridge * w01 + c11.ridge * w11;
+    return climate;
+}
+
+BIOME_ENUM get_biome(const ClimateSample &climate)
+{
+    if (climate.mix > 0.6f)
+        return BIOME_PLAIN;
+    if (climate.mix > 0.2f)
+        return BIOME_HILLS;
+    return BIOME_MOUNTAIN;
+}
+
+BLOCK_ENUM get_biome_surface_block(BIOME_ENUM biome)
+{
+    if (biome == BIOME_MOUNTAIN)
+        return BLOCK_STONE; // 山地裸露岩石
+    return BLOCK_GRASS;
+}
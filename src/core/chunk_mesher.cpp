@@ -0,0 +1,520 @@
+#include "chunk_mesher.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+
+BLOCK_ENUM block_face_tile(BLOCK_ENUM kind, int face)
+{
+    if (kind == BLOCK_GRASS)
+        return face == FACE_U ? RENDER_GRASS_TOP : face == FACE_D ? BLOCK_DIRT : BLOCK_GRASS;
+    if (kind == BLOCK_TNT)
+        return face == FACE_U ? BLOCK_TNT_TOP : face == FACE_D ? BLOCK_TNT_BOTTOM : BLOCK_TNT;
+    return kind;
+}
+
+// 向量中唯一的非零分量
+static inline int axis_of(glm::ivec3 v)
+{
+    return v.x != 0 ? 0 : v.y != 0 ? 1 : 2;
+}
+
+// 面f的切片坐标系：切片s沿法线轴n，切片内坐标(a, b)沿面内u/v轴递增，保证合并出的矩形从起始方块沿axis_u/axis_v延伸
+struct FaceSliceAxes
+{
+    int n, ua, va; // 法线轴和面内u/v轴对应的分量
+    bool su, sv;   // 面内u/v轴是否沿坐标轴正方向
+};
+
+static FaceSliceAxes face_slice_axes(int f)
+{
+    FaceSliceAxes axes;
+    axes.n = axis_of(MESH_FACE_DIR[f]);
+    axes.ua = axis_of(MESH_FACE_AXIS_U[f]);
+    axes.va = axis_of(MESH_FACE_AXIS_V[f]);
+    axes.su = MESH_FACE_AXIS_U[f][axes.ua] > 0;
+    axes.sv = MESH_FACE_AXIS_V[f][axes.va] > 0;
+    return axes;
+}
+
+// len为切片边长（粗格网格化时小于CHUNK_LEN）
+static inline glm::ivec3 slice_to_local(const FaceSliceAxes &axes, int s, int a, int b, int len = CHUNK_LEN)
+{
+    glm::ivec3 local;
+    local[axes.n] = s;
+    local[axes.ua] = axes.su ? a : len - 1 - a;
+    local[axes.va] = axes.sv ? b : len - 1 - b;
+    return local;
+}
+
+// 在切片的贴图掩码（-1为不可见）上贪心合并：先沿u轴尽量延伸，再整行沿v轴延伸，每个矩形调用emit(a, b, w, h, tile)
+template <typename Emit>
+static void merge_slice(int mask[CHUNK_LEN][CHUNK_LEN], int len, Emit emit)
+{
+    for (int b = 0; b < len; ++b)
+    {
+        for (int a = 0; a < len; ++a)
+        {
+            int tile = mask[a][b];
+            if (tile < 0)
+                continue;
+            int w = 1, h = 1;
+            while (a + w < len && mask[a + w][b] == tile)
+                ++w;
+            for (; b + h < len; ++h)
+            {
+                bool same = true;
+                for (int i = a; i < a + w && same; ++i)
+                    same = mask[i][b + h] == tile;
+                if (!same)
+                    break;
+            }
+            for (int j = b; j < b + h; ++j)
+                for (int i = a; i < a + w; ++i)
+                    mask[i][j] = -1;
+            emit(a, b, w, h, tile);
+        }
+    }
+}
+
+int chunk_lod_scale(glm::ivec3 cpos, glm::ivec3 center)
+{
+    float distance = glm::length(glm::vec3(cpos - center));
+    return distance <= MESH_LOD_FULL_RADIUS ? 1 : distance <= MESH_LOD_HALF_RADIUS ? 2 : 4;
+}
+
+// 粗格是否实心：不透明方块不少于一半（区块内和快照中的粗格都按这条规则，相邻同精度区块的判断才一致）
+static inline bool lod_majority(int opaque_count, int scale)
+{
+    return opaque_count * 2 >= scale * scale * scale;
+}
+
+// 区块中边长为scale的粗格cell是否实心
+static bool lod_cell_solid(const Chunk *chunk, int scale, glm::ivec3 cell)
+{
+    int count = 0;
+    for (int i = 0; i < scale; ++i)
+        for (int j = 0; j < scale; ++j)
+            for (int k = 0; k < scale; ++k)
+            {
+                Block *block = chunk->blocks[cell.x * scale + i][cell.y * scale + j][cell.z * scale + k];
+                count += block && block->kind != BLOCK_AIR && !block->transparent;
+            }
+    return lod_majority(count, scale);
+}
+
+void mesh_chunk_greedy(const Chunk *chunk, std::vector<ChunkQuad> &quads)
+{
+    glm::ivec3 base(chunk->cx * CHUNK_LEN, chunk->cy * CHUNK_LEN, chunk->cz * CHUNK_LEN);
+
+    // 区块及其六个邻接面上的方块是否暴露（空气或尚未生成），下标整体偏移1
+    bool exposed[MESH_PAD][MESH_PAD][MESH_PAD];
+    for (int i = 0; i < MESH_PAD; ++i)
+    {
+        for (int j = 0; j < MESH_PAD; ++j)
+        {
+            for (int k = 0; k < MESH_PAD; ++k)
+            {
+                glm::ivec3 local(i - 1, j - 1, k - 1);
+                int outside = (local.x < 0 || local.x >= CHUNK_LEN) + (local.y < 0 || local.y >= CHUNK_LEN) + (local.z < 0 || local.z >= CHUNK_LEN);
+                exposed[i][j][k] = false;
+                if (outside == 0)
+                {
+                    Block *block = chunk->blocks[local.x][local.y][local.z];
+                    exposed[i][j][k] = !block || block->kind == BLOCK_AIR;
+                }
+                else if (outside == 1) // 棱和角上的方块不与区块内任何面相邻
+                {
+                    glm::ivec3 pos = base + local;
+                    if (pos.x < 0 || pos.y < 0 || pos.z < 0)
+                        continue; // 世界边界外的面不渲染
+                    Block *block = get_block(pos);
+                    exposed[i][j][k] = !block || block->kind == BLOCK_AIR;
+                }
+            }
+        }
+    }
+
+    int mask[CHUNK_LEN][CHUNK_LEN]; // 当前切片上每个位置可见面的贴图，-1为不可见
+    for (int f = 0; f < 6; ++f)
+    {
+        glm::ivec3 dir = MESH_FACE_DIR[f];
+        FaceSliceAxes axes = face_slice_axes(f);
+
+        for (int s = 0; s < CHUNK_LEN; ++s)
+        {
+            for (int a = 0; a < CHUNK_LEN; ++a)
+            {
+                for (int b = 0; b < CHUNK_LEN; ++b)
+                {
+                    mask[a][b] = -1;
+                    glm::ivec3 local = slice_to_local(axes, s, a, b);
+                    Block *block = chunk->blocks[local.x][local.y][local.z];
+                    if (!block || block->kind == BLOCK_AIR)
+                        continue;
+                    glm::ivec3 near_pos = local + dir + 1;
+                    if (block->transparent || exposed[near_pos.x][near_pos.y][near_pos.z])
+                        mask[a][b] = block_face_tile(block->kind, f);
+                }
+            }
+
+            merge_slice(mask, CHUNK_LEN, [&](int a, int b, int w, int h, int tile)
+                        { quads.push_back({slice_to_local(axes, s, a, b), f, w, h, (BLOCK_ENUM)tile}); });
+        }
+    }
+}
+
+void snapshot_chunk(const Chunk *chunk, ChunkSnapshot &snapshot, const glm::ivec3 *lod_center)
+{
+    snapshot.cpos = glm::ivec3(chunk->cx, chunk->cy, chunk->cz);
+    snapshot.lod_scale = lod_center ? chunk_lod_scale(snapshot.cpos, *lod_center) : 1;
+    memset(snapshot.cells, 0, sizeof(snapshot.cells));
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+            {
+                Block *block = chunk->blocks[i][j][k];
+                snapshot.kinds[i][j][k] = block ? block->kind : BLOCK_AIR;
+                if (!block || block->kind == BLOCK_AIR)
+                    continue;
+                snapshot.cells[i + 1][j + 1][k + 1] = SNAPSHOT_SOLID | (block->transparent ? SNAPSHOT_TRANSPARENT : 0);
+            }
+
+    // 一圈邻居（含棱和角，环境光遮蔽需要）：26个相邻区块各取一次，而不是逐个方块查找
+    Chunk *near_chunks[3][3][3];
+    bool outside_world[3][3][3]; // 世界边界外的位置视为实心，其上的面不渲染
+    for (int dx = -1; dx <= 1; ++dx)
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dz = -1; dz <= 1; ++dz)
+            {
+                glm::ivec3 near_cpos = snapshot.cpos + glm::ivec3(dx, dy, dz);
+                bool outside = near_cpos.x < 0 || near_cpos.y < 0 || near_cpos.z < 0;
+                outside_world[dx + 1][dy + 1][dz + 1] = outside;
+                Chunk *near_chunk = outside ? nullptr : get_chunk(near_cpos.x, near_cpos.y, near_cpos.z);
+                if (near_chunk && lod_center && chunk_lod_scale(near_cpos, *lod_center) != snapshot.lod_scale)
+                    near_chunk = nullptr; // 精度不同的邻居视为空气，交界面由两侧各自渲染
+                near_chunks[dx + 1][dy + 1][dz + 1] = near_chunk;
+            }
+    for (int i = 0; i < MESH_PAD; ++i)
+        for (int j = 0; j < MESH_PAD; ++j)
+            for (int k = 0; k < MESH_PAD; ++k)
+            {
+                glm::ivec3 local(i - 1, j - 1, k - 1);
+                glm::ivec3 d = glm::ivec3(local.x >= CHUNK_LEN, local.y >= CHUNK_LEN, local.z >= CHUNK_LEN) - glm::ivec3(local.x < 0, local.y < 0, local.z < 0);
+                if (d == glm::ivec3(0))
+                    continue; // 区块内部已经填好
+                if (outside_world[d.x + 1][d.y + 1][d.z + 1])
+                {
+                    snapshot.cells[i][j][k] = SNAPSHOT_SOLID;
+                    continue;
+                }
+                Chunk *near_chunk = near_chunks[d.x + 1][d.y + 1][d.z + 1];
+                if (!near_chunk)
+                    continue; // 未生成的区块视为空气
+                glm::ivec3 near_local = local - d * CHUNK_LEN;
+                Block *block = near_chunk->blocks[near_local.x][near_local.y][near_local.z];
+                if (block && block->kind != BLOCK_AIR)
+                    snapshot.cells[i][j][k] = SNAPSHOT_SOLID | (block->transparent ? SNAPSHOT_TRANSPARENT : 0);
+            }
+
+    if (snapshot.lod_scale == 1)
+        return;
+    // 粗格网格化只看六个面相邻区块贴边的一层粗格，按与区块内相同的规则判断是否实心
+    int scale = snapshot.lod_scale, len = CHUNK_LEN / scale;
+    for (int f = 0; f < 6; ++f)
+    {
+        glm::ivec3 dir = MESH_FACE_DIR[f];
+        int axis = axis_of(dir), o1 = axis == 0 ? 1 : 0, o2 = axis == 2 ? 1 : 2;
+        bool outside = outside_world[dir.x + 1][dir.y + 1][dir.z + 1];
+        Chunk *near_chunk = near_chunks[dir.x + 1][dir.y + 1][dir.z + 1];
+        for (int p = 0; p < len; ++p)
+            for (int q = 0; q < len; ++q)
+            {
+                glm::ivec3 cell;
+                cell[axis] = dir[axis] > 0 ? 0 : len - 1;
+                cell[o1] = p;
+                cell[o2] = q;
+                snapshot.lod_near[f][p][q] = outside || (near_chunk && lod_cell_solid(near_chunk, scale, cell));
+            }
+    }
+}
+
+// 面f上方块local的四个顶点的环境光遮蔽等级（0最暗，3不遮挡），按角点cu + 2 * cv每个占2位：
+// 顶点在面前方一层的两个侧邻和一个角邻中，不透明方块越多越暗，两个侧邻都不透明时最暗
+static uint8_t face_ambient_occlusion(const ChunkSnapshot &snapshot, glm::ivec3 local, int f)
+{
+    glm::ivec3 front = local + MESH_FACE_DIR[f] + 1; // 带边坐标
+    auto opaque = [&](glm::ivec3 p)
+    {
+        uint8_t cell = snapshot.cells[p.x][p.y][p.z];
+        return (cell & SNAPSHOT_SOLID) && !(cell & SNAPSHOT_TRANSPARENT);
+    };
+    uint8_t ao = 0;
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        glm::ivec3 du = (corner & 1) ? MESH_FACE_AXIS_U[f] : -MESH_FACE_AXIS_U[f];
+        glm::ivec3 dv = (corner & 2) ? MESH_FACE_AXIS_V[f] : -MESH_FACE_AXIS_V[f];
+        int side_u = opaque(front + du), side_v = opaque(front + dv), diagonal = opaque(front + du + dv);
+        int level = side_u && side_v ? 0 : 3 - side_u - side_v - diagonal;
+        ao |= level << (corner * 2);
+    }
+    return ao;
+}
+
+void mesh_chunk_binary(const Chunk *chunk, std::vector<ChunkQuad> &quads)
+{
+    ChunkSnapshot snapshot;
+    snapshot_chunk(chunk, snapshot);
+    mesh_snapshot_binary(snapshot, quads);
+}
+
+// 按快照的lod_scale把方块合并成粗格后贪心网格化，四边形仍以方块为单位（贴图按方块重复，远处纹理密度不变）
+static void mesh_snapshot_lod(const ChunkSnapshot &snapshot, std::vector<ChunkQuad> &quads)
+{
+    const int scale = snapshot.lod_scale, len = CHUNK_LEN / scale;
+    bool solid[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN] = {};
+    BLOCK_ENUM top[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN];      // 格内最高一层的不透明方块，用于顶面
+    BLOCK_ENUM majority[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN]; // 格内数量最多的不透明方块，用于其余面
+    for (int x = 0; x < len; ++x)
+        for (int y = 0; y < len; ++y)
+            for (int z = 0; z < len; ++z)
+            {
+                BLOCK_ENUM kinds[CHUNK_LEN * CHUNK_LEN * CHUNK_LEN]; // 最多scale^3种
+                int counts[CHUNK_LEN * CHUNK_LEN * CHUNK_LEN];
+                int kind_count = 0, opaque_count = 0, best = 0;
+                bool has_top = false;
+                for (int j = scale - 1; j >= 0; --j) // 从上往下，第一个找到的就是顶面方块
+                    for (int i = 0; i < scale; ++i)
+                        for (int k = 0; k < scale; ++k)
+                        {
+                            glm::ivec3 local(x * scale + i, y * scale + j, z * scale + k);
+                            uint8_t cell = snapshot.cells[local.x + 1][local.y + 1][local.z + 1];
+                            if (!(cell & SNAPSHOT_SOLID) || (cell & SNAPSHOT_TRANSPARENT))
+                                continue;
+                            BLOCK_ENUM kind = snapshot.kinds[local.x][local.y][local.z];
+                            ++opaque_count;
+                            if (!has_top)
+                            {
+                                top[x][y][z] = kind;
+                                has_top = true;
+                            }
+                            int n = 0;
+                            while (n < kind_count && kinds[n] != kind)
+                                ++n;
+                            if (n == kind_count)
+                            {
+                                kinds[kind_count] = kind;
+                                counts[kind_count++] = 0;
+                            }
+                            if (++counts[n] > counts[best])
+                                best = n;
+                        }
+                solid[x][y][z] = lod_majority(opaque_count, scale);
+                if (solid[x][y][z])
+                    majority[x][y][z] = kinds[best];
+            }
+
+    int mask[CHUNK_LEN][CHUNK_LEN];
+    for (int f = 0; f < 6; ++f)
+    {
+        glm::ivec3 dir = MESH_FACE_DIR[f];
+        FaceSliceAxes axes = face_slice_axes(f);
+        int o1 = axes.n == 0 ? 1 : 0, o2 = axes.n == 2 ? 1 : 2;
+        for (int s = 0; s < len; ++s)
+        {
+            for (int a = 0; a < len; ++a)
+            {
+                for (int b = 0; b < len; ++b)
+                {
+                    mask[a][b] = -1;
+                    glm::ivec3 cell = slice_to_local(axes, s, a, b, len);
+                    if (!solid[cell.x][cell.y][cell.z])
+                        continue;
+                    glm::ivec3 near_cell = cell + dir;
+                    bool covered;
+                    if (near_cell[axes.n] < 0 || near_cell[axes.n] >= len)
+                        covered = snapshot.lod_near[f][cell[o1]][cell[o2]];
+                    else
+                        covered = solid[near_cell.x][near_cell.y][near_cell.z];
+                    if (!covered)
+                        mask[a][b] = block_face_tile(f == FACE_U ? top[cell.x][cell.y][cell.z] : majority[cell.x][cell.y][cell.z], f);
+                }
+            }
+            merge_slice(mask, len, [&](int a, int b, int w, int h, int tile)
+                        {
+                            // 起始格中面原点所在的方块，使pos + MESH_FACE_ORIGIN落在粗格的面原点上
+                            glm::ivec3 pos = slice_to_local(axes, s, a, b, len) * scale + (scale - 1) * MESH_FACE_ORIGIN[f];
+                            quads.push_back({pos, f, w * scale, h * scale, (BLOCK_ENUM)tile}); });
+        }
+    }
+}
+
+void mesh_snapshot_binary(const ChunkSnapshot &snapshot, std::vector<ChunkQuad> &quads, std::vector<ChunkQuad> *translucent_quads)
+{
+    if (snapshot.lod_scale > 1)
+    {
+        mesh_snapshot_lod(snapshot, quads);
+        return;
+    }
+    static const uint32_t KEY_TRANSLUCENT = 1u << 24; // 透明方块的面不与不透明的面合并
+    // 三个方向的占用列：cols[轴][另外两轴的带边坐标（升序）]的第i位对应该轴带边坐标i（区块内坐标i - 1）
+    uint64_t solid[3][MESH_PAD][MESH_PAD] = {};       // 区块内的非空气方块
+    uint64_t blocked[3][MESH_PAD][MESH_PAD] = {};     // 会遮挡相邻面的位置（非空气方块或世界边界外）
+    uint64_t transparent[3][MESH_PAD][MESH_PAD] = {}; // 透明方块，总是渲染全部六个面
+    auto set_cell = [](uint64_t cols[3][MESH_PAD][MESH_PAD], int i, int j, int k)
+    {
+        cols[0][j][k] |= 1ull << i;
+        cols[1][i][k] |= 1ull << j;
+        cols[2][i][j] |= 1ull << k;
+    };
+    for (int i = 0; i < MESH_PAD; ++i)
+        for (int j = 0; j < MESH_PAD; ++j)
+            for (int k = 0; k < MESH_PAD; ++k)
+            {
+                uint8_t cell = snapshot.cells[i][j][k];
+                if (!(cell & SNAPSHOT_SOLID))
+                    continue;
+                set_cell(blocked, i, j, k);
+                bool inside = i > 0 && i <= CHUNK_LEN && j > 0 && j <= CHUNK_LEN && k > 0 && k <= CHUNK_LEN;
+                if (inside)
+                    set_cell(solid, i, j, k);
+                if (cell & SNAPSHOT_TRANSPARENT)
+                    set_cell(transparent, i, j, k);
+            }
+
+    // 整列移位求出暴露的面，只访问置位的方块，写入每个面每个切片的位平面
+    static const int FACE_OF_AXIS[3][2] = {{FACE_R, FACE_L}, {FACE_D, FACE_U}, {FACE_F, FACE_B}}; // [轴][是否正方向]
+    FaceSliceAxes axes[6];
+    for (int f = 0; f < 6; ++f)
+        axes[f] = face_slice_axes(f);
+    uint64_t planes[6][CHUNK_LEN][CHUNK_LEN] = {}; // [面][切片][b]的第a位
+    uint32_t keys[6][CHUNK_LEN][CHUNK_LEN][CHUNK_LEN]; // [面][切片][a][b]：贴图 | 环境光遮蔽 << 16 | KEY_TRANSLUCENT，只有planes置位处有效
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int o1 = axis == 0 ? 1 : 0, o2 = axis == 2 ? 1 : 2;
+        for (int p = 1; p <= CHUNK_LEN; ++p)
+            for (int q = 1; q <= CHUNK_LEN; ++q)
+            {
+                uint64_t column = solid[axis][p][q];
+                if (!column)
+                    continue;
+                uint64_t occluder = blocked[axis][p][q], see_through = transparent[axis][p][q];
+                uint64_t visible[2] = {column & (~(occluder << 1) | see_through),  // 负方向的邻居为空
+                                       column & (~(occluder >> 1) | see_through)}; // 正方向的邻居为空
+                for (int positive = 0; positive < 2; ++positive)
+                {
+                    int f = FACE_OF_AXIS[axis][positive];
+                    const FaceSliceAxes &fa = axes[f];
+                    for (uint64_t bits = visible[positive]; bits; bits &= bits - 1)
+                    {
+                        glm::ivec3 local;
+                        local[axis] = __builtin_ctzll(bits) - 1;
+                        local[o1] = p - 1;
+                        local[o2] = q - 1;
+                        int s = local[fa.n];
+                        int a = fa.su ? local[fa.ua] : CHUNK_LEN - 1 - local[fa.ua];
+                        int b = fa.sv ? local[fa.va] : CHUNK_LEN - 1 - local[fa.va];
+                        planes[f][s][b] |= 1ull << a;
+                        // 透明方块（花、蜘蛛网）不做遮蔽
+                        bool see_through_block = snapshot.cells[local.x + 1][local.y + 1][local.z + 1] & SNAPSHOT_TRANSPARENT;
+                        uint8_t ao = see_through_block ? MESH_AO_NONE : face_ambient_occlusion(snapshot, local, f);
+                        keys[f][s][a][b] = block_face_tile(snapshot.kinds[local.x][local.y][local.z], f) | (uint32_t)ao << 16 | (see_through_block ? KEY_TRANSLUCENT : 0);
+                    }
+                }
+            }
+    }
+
+    // 在位平面上贪心合并：同一行用移位找连续同贴图同遮蔽的段，再用AND检查下一行是否整段可并；
+    // 四角遮蔽不一致的面单独成一个四边形，否则合并后插值会把明暗拉伸到整个矩形上
+    for (int f = 0; f < 6; ++f)
+        for (int s = 0; s < CHUNK_LEN; ++s)
+            for (int b = 0; b < CHUNK_LEN; ++b)
+                while (planes[f][s][b])
+                {
+                    uint64_t row = planes[f][s][b];
+                    int a = __builtin_ctzll(row);
+                    uint32_t key = keys[f][s][a][b];
+                    uint8_t ao = key >> 16;
+                    bool mergeable = ao == 0x00 || ao == 0x55 || ao == 0xAA || ao == 0xFF; // 四角等级相同
+                    int w = 1, h = 1;
+                    while (mergeable && a + w < CHUNK_LEN && (row >> (a + w) & 1) && keys[f][s][a + w][b] == key)
+                        ++w;
+                    uint64_t run = ((1ull << w) - 1) << a;
+                    for (; mergeable && b + h < CHUNK_LEN && (planes[f][s][b + h] & run) == run; ++h)
+                    {
+                        bool same = true;
+                        for (int i = a; i < a + w && same; ++i)
+                            same = keys[f][s][i][b + h] == key;
+                        if (!same)
+                            break;
+                    }
+                    for (int j = b; j < b + h; ++j)
+                        planes[f][s][j] &= ~run;
+                    ChunkQuad quad = {slice_to_local(axes[f], s, a, b), f, w, h, (BLOCK_ENUM)(key & 0xFFFF), ao};
+                    if ((key & KEY_TRANSLUCENT) && translucent_quads)
+                        translucent_quads->push_back(quad);
+                    else
+                        quads.push_back(quad);
+                }
+}
+
+void build_chunk_vertices(const std::vector<ChunkQuad> &quads, std::vector<ChunkVertex> &vertices)
+{
+    // 顶点顺序与load_meshes中的单位面一致：左下、右下、右上、左上（逆时针为正面），QUAD_INDEX_PATTERN的对角线为左下-右上
+    const glm::ivec2 corners[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    // 左下、右上两角比另外两角暗时从右下开始排列，对角线换成右下-左上，避免遮蔽插值出现各向异性的折痕
+    const glm::ivec2 flipped_corners[4] = {{1, 0}, {1, 1}, {0, 1}, {0, 0}};
+    static const uint8_t AO_LIGHT[4] = {128, 176, 216, MESH_LIGHT_FULL}; // 遮蔽等级对应的顶点亮度
+    vertices.reserve(vertices.size() + quads.size() * 4);
+    for (const ChunkQuad &quad : quads)
+    {
+        glm::ivec3 origin = quad.pos + MESH_FACE_ORIGIN[quad.face];
+        auto level = [&](glm::ivec2 corner)
+        { return (quad.ao >> ((corner.x + 2 * corner.y) * 2)) & 3; };
+        bool flip = level({0, 0}) + level({1, 1}) < level({1, 0}) + level({0, 1});
+        for (int c = 0; c < 4; ++c)
+        {
+            glm::ivec2 corner = flip ? flipped_corners[c] : corners[c];
+            glm::ivec3 position = origin + corner.x * quad.w * MESH_FACE_AXIS_U[quad.face] + corner.y * quad.h * MESH_FACE_AXIS_V[quad.face];
+            vertices.push_back(ChunkVertex::pack(position, quad.face, quad.tile, AO_LIGHT[level(corner)]));
+        }
+    }
+}
+
+Mesh *create_chunk_mesh(const std::vector<ChunkQuad> &quads, bool translucent)
+{
+    if (quads.empty())
+        return nullptr;
+    Mesh *mesh = new Mesh();
+    build_chunk_vertices(quads, mesh->_packed_vertices);
+    if (translucent)
+    {
+        mesh->_indices.resize(quads.size() * 6);
+        for (int i = 0; i < mesh->_indices.size(); ++i)
+            mesh->_indices[i] = i / 6 * 4 + QUAD_INDEX_PATTERN[i % 6];
+        mesh->_quad_centers.reserve(quads.size());
+        for (const ChunkQuad &quad : quads)
+        {
+            glm::vec3 extent = glm::vec3(quad.w * MESH_FACE_AXIS_U[quad.face] + quad.h * MESH_FACE_AXIS_V[quad.face]);
+            mesh->_quad_centers.push_back(glm::vec3(quad.pos + MESH_FACE_ORIGIN[quad.face]) + extent * 0.5f);
+        }
+    }
+    return mesh;
+}
+
+void sort_translucent_quads(Mesh *mesh, glm::vec3 camera_local)
+{
+    std::vector<int> order(mesh->_quad_centers.size());
+    std::vector<float> distance(order.size());
+    for (int i = 0; i < order.size(); ++i)
+    {
+        order[i] = i;
+        glm::vec3 d = mesh->_quad_centers[i] - camera_local;
+        distance[i] = glm::dot(d, d);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+              { return distance[a] > distance[b]; });
+    for (int i = 0; i < order.size(); ++i)
+        for (int c = 0; c < 6; ++c)
+            mesh->_indices[i * 6 + c] = order[i] * 4 + QUAD_INDEX_PATTERN[c];
+}
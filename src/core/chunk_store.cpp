@@ -0,0 +1,99 @@
+#include "chunk_store.h"
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+
+// 文件头，后面紧跟CHUNK_LEN_CUBIC个字节的方块种类（按x->y->z顺序）
+struct ChunkFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    int32_t chunk_len;
+    int32_t cx, cy, cz;
+    uint64_t fingerprint; // 生成该区块时的世界生成器指纹
+};
+
+static uint64_t __chunk_store_fingerprint = 0;
+
+void set_chunk_store_fingerprint(uint64_t fingerprint)
+{
+    __chunk_store_fingerprint = fingerprint;
+}
+
+static bool header_matches(const ChunkFileHeader &header, int cx, int cy, int cz)
+{
+    return header.magic == CHUNK_STORE_MAGIC && header.version == CHUNK_STORE_VERSION && header.chunk_len == CHUNK_LEN &&
+           header.cx == cx && header.cy == cy && header.cz == cz && header.fingerprint == __chunk_store_fingerprint;
+}
+
+std::string chunk_store_path(int cx, int cy, int cz)
+{
+    return std::string(WORLD_DIR) + "c." + std::to_string(cx) + "." + std::to_string(cy) + "." + std::to_string(cz) + ".bin";
+}
+
+bool chunk_stored(int cx, int cy, int cz)
+{
+    FILE *file = fopen(chunk_store_path(cx, cy, cz).c_str(), "rb");
+    if (!file)
+        return false;
+    ChunkFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+    return ok && header_matches(header, cx, cy, cz);
+}
+
+bool save_chunk(const Chunk *chunk)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(WORLD_DIR, ec);
+
+    ChunkFileHeader header{CHUNK_STORE_MAGIC, CHUNK_STORE_VERSION, CHUNK_LEN, chunk->cx, chunk->cy, chunk->cz, __chunk_store_fingerprint};
+    uint8_t kinds[CHUNK_LEN_CUBIC];
+    int n = 0;
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+            {
+                Block *block = chunk->blocks[i][j][k];
+                kinds[n++] = (uint8_t)(block ? block->kind : BLOCK_AIR);
+            }
+
+    std::string path = chunk_store_path(chunk->cx, chunk->cy, chunk->cz);
+    std::string tmp_path = path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file)
+    {
+        printf("Failed to open chunk file %s\n", tmp_path.c_str());
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(kinds, sizeof(kinds), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+    {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+bool load_chunk(Chunk *chunk)
+{
+    FILE *file = fopen(chunk_store_path(chunk->cx, chunk->cy, chunk->cz).c_str(), "rb");
+    if (!file)
+        return false;
+    ChunkFileHeader header;
+    uint8_t kinds[CHUNK_LEN_CUBIC];
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && fread(kinds, sizeof(kinds), 1, file) == 1;
+    fclose(file);
+    if (!ok || !header_matches(header, chunk->cx, chunk->cy, chunk->cz))
+        return false;
+
+    int x_min = chunk->cx * CHUNK_LEN, y_min = chunk->cy * CHUNK_LEN, z_min = chunk->cz * CHUNK_LEN;
+    int n = 0;
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+                chunk->blocks[i][j][k] = new Block(x_min + i, y_min + j, z_min + k, (BLOCK_ENUM)kinds[n++]);
+    return true;
+}
@@ -0,0 +1,78 @@
+#include "mesh_worker.h"
+
+void ChunkMeshWorkers::start(int thread_count)
+{
+    _stopping = false;
+    for (int i = 0; i < thread_count; ++i)
+        _threads.emplace_back(&ChunkMeshWorkers::run, this);
+}
+
+void ChunkMeshWorkers::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+        for (Job *job : _jobs)
+            delete job;
+        _jobs.clear();
+    }
+    _job_ready.notify_all();
+    for (std::thread &thread : _threads)
+        thread.join();
+    _threads.clear();
+    for (MeshedChunk &result : _done)
+    { // 还没有上传，直接释放
+        delete result.mesh;
+        delete result.translucent_mesh;
+    }
+    _done.clear();
+}
+
+void ChunkMeshWorkers::submit(Chunk *chunk, glm::ivec3 lod_center)
+{
+    Job *job = new Job(); // 快照较大，放在堆上
+    job->chunk = chunk;
+    job->version = chunk->mesh_version;
+    snapshot_chunk(chunk, job->snapshot, &lod_center);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(job);
+    }
+    _job_ready.notify_one();
+}
+
+void ChunkMeshWorkers::collect(std::vector<MeshedChunk> &results)
+{
+    results.clear();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done.swap(results);
+}
+
+void ChunkMeshWorkers::run()
+{
+    std::vector<ChunkQuad> quads, translucent_quads;
+    while (true)
+    {
+        Job *job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _job_ready.wait(lock, [this]
+                            { return _stopping || !_jobs.empty(); });
+            if (_stopping)
+                return;
+            job = _jobs.front();
+            _jobs.pop_front();
+        }
+
+        quads.clear();
+        translucent_quads.clear();
+        mesh_snapshot_binary(job->snapshot, quads, &translucent_quads);
+        Mesh *mesh = create_chunk_mesh(quads, false);
+        Mesh *translucent_mesh = create_chunk_mesh(translucent_quads, true);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done.push_back({job->chunk, job->version, mesh, translucent_mesh});
+        }
+        delete job;
+    }
+}
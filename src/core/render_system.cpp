@@ -1,10 +1,21 @@
 #include "render_system.h"
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 
 std::vector<RenderObject> __renderables;
+std::vector<int *> __renderable_owners;
+std::vector<int> __free_renderables;
+std::vector<int> __dirty_renderables;
 std::vector<Chunk *> __rendered_chunks;
 std::unordered_map<std::string, Material> __materials;
-std::vector<Mesh> __meshes(TEXTURE_SIZE * TEXTURE_SIZE + 1);
+Mesh __face_mesh;
+std::vector<Mesh *> __pending_meshes;
+std::vector<Mesh *> __retired_meshes;
+std::vector<Mesh *> __resorted_meshes;
+std::vector<Chunk *> __dirty_chunks;
+ChunkMeshWorkers __mesh_workers;
+glm::ivec3 __lod_center;
+bool __gpu_culling = false;
 
 Material *RenderSystem::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string &name)
 {
@@ -29,79 +40,112 @@ Material *RenderSystem::get_material(const std::string &name)
     }
 }
 
-// returns nullptr if it can't be found
-Mesh *RenderSystem::get_mesh(BLOCK_ENUM block_kind)
+// 不再使用的区块网格：尚未上传的直接删除，已上传的交给VenomApp延迟释放显存
+static void retire_mesh(Mesh *mesh)
 {
-    int block_id = (int)block_kind;
-    if (block_id < __meshes.size())
+    if (!mesh)
+        return;
+    __resorted_meshes.erase(std::remove(__resorted_meshes.begin(), __resorted_meshes.end(), mesh), __resorted_meshes.end());
+    auto it = std::find(__pending_meshes.begin(), __pending_meshes.end(), mesh);
+    if (it != __pending_meshes.end())
     {
-        return &__meshes[block_id];
+        __pending_meshes.erase(it);
+        delete mesh;
+        return;
     }
-    return nullptr;
+    __retired_meshes.push_back(mesh);
 }
 
 // 初始场景布置【重要】
 void RenderSystem::init_scene()
 {
     DEFAULT_MATERIAL = get_material("textured");
+    CHUNK_MATERIAL = get_material("chunk");
+    CHUNK_TRANSLUCENT_MATERIAL = get_material("chunk_translucent");
     init_terrain_heights();
     import_model_resources();
-    render_all_chunks(__player_init_pos, false);
+    render_all_chunks(__player_init_pos, false); // 出生点附近的区块同步网格化，第一帧就完整
+    __mesh_workers.start(MESH_WORKER_COUNT);
+    noise_tile_cache().print_stats();
 }
 
-// 渲染Block的一个面【该方法不带值检查，另外在renderable放置完之后记得赋值face_id】
-void RenderSystem::render_face(Block *block, int i)
+// 把对象放进一个空闲槽位（没有则追加），槽位索引写入*owner；*owner原来占有的槽位先释放
+void RenderSystem::add_renderable(const RenderObject &object, int *owner)
 {
-    block->faces[i].material = DEFAULT_MATERIAL;
-    glm::mat4 translation = glm::translate(glm::mat4{1.0}, glm::vec3(block->pos) + BLOCK_TRANSLATE_DIST[i]);
-    block->faces[i].model_transform = translation * BLOCK_ROTATION[i];
-    block->faces[i].normal = FACE_NORMALS[i];
-    // 各面不同的渲染
-    if (block->kind == BLOCK_GRASS)
+    remove_renderable(owner);
+    int index;
+    if (!__free_renderables.empty())
     {
-        if (i == FACE_U)
-        { // U
-            block->faces[i].mesh = get_mesh(RENDER_GRASS_TOP);
-            return;
-        }
-        if (i == FACE_D)
-        { // D
-            block->faces[i].mesh = get_mesh(BLOCK_DIRT);
-            return;
-        }
-        block->faces[i].mesh = get_mesh(BLOCK_GRASS);
-        return;
+        index = __free_renderables.back();
+        __free_renderables.pop_back();
+        __renderables[index] = object;
+        __renderable_owners[index] = owner;
     }
-    if (block->kind == BLOCK_TNT)
+    else
     {
-        if (i == FACE_U)
-        { // U
-            block->faces[i].mesh = get_mesh(BLOCK_TNT_TOP);
-            return;
-        }
-        if (i == FACE_D)
-        { // D
-            block->faces[i].mesh = get_mesh(BLOCK_TNT_BOTTOM);
-            return;
-        }
-        block->faces[i].mesh = get_mesh(BLOCK_TNT);
-        return;
+        index = __renderables.size();
+        __renderables.push_back(object);
+        __renderable_owners.push_back(owner);
     }
-
-    block->faces[i].mesh = get_mesh(block->kind);
+    *owner = index;
+    __dirty_renderables.push_back(index);
 }
 
-// 取消渲染Block的一个面【该方法不带值检查】
-void RenderSystem::unrender_face(Block *block, int i)
+// 释放*owner占有的槽位，槽位留空等待复用
+void RenderSystem::remove_renderable(int *owner)
 {
-    int index = block->face_id[i];
+    int index = *owner;
     if (index == FACE_UNRENDERED)
-        return; // 这个面没有渲染
-    block->face_id[i] = FACE_UNRENDERED;
+        return; // 没有占用槽位
+    *owner = FACE_UNRENDERED;
     if (index >= __renderables.size())
-        return; // 【在区块交界处调用render_all_blocks()时清空了renderables，进入该分支】
+        return;
     __renderables[index].mesh = nullptr;
     __renderables[index].material = nullptr;
+    __renderable_owners[index] = nullptr;
+    __free_renderables.push_back(index);
+}
+
+// 空槽位过多时把存活对象前移，并改写其所有者记录的索引，使每帧遍历的槽位数与存活对象数成正比
+void RenderSystem::compact_renderables()
+{
+    if (__free_renderables.size() < RENDERABLE_COMPACT_MIN || __free_renderables.size() * 2 < __renderables.size())
+        return;
+    int live = 0;
+    for (int i = 0; i < __renderables.size(); ++i)
+    {
+        int *owner = __renderable_owners[i];
+        if (!owner)
+            continue;
+        if (i != live)
+        {
+            __renderables[live] = __renderables[i];
+            __renderable_owners[live] = owner;
+            *owner = live;
+            __dirty_renderables.push_back(live);
+        }
+        ++live;
+    }
+    __renderables.resize(live);
+    __renderable_owners.resize(live);
+    __free_renderables.clear();
+}
+
+// 渲染Block的一个面【该方法不带值检查，之后用add_renderable放入__renderables】
+void RenderSystem::render_face(Block *block, int i)
+{
+    block->faces[i].material = DEFAULT_MATERIAL;
+    block->faces[i].pos = block->pos;
+    block->faces[i].face = i;
+    // 所有面共用同一个网格，贴图编号随物体数据传给着色器（草方块和TNT的顶面/底面与侧面不同）
+    block->faces[i].mesh = &__face_mesh;
+    block->faces[i].tile = block_face_tile(block->kind, i);
+}
+
+// 取消渲染Block的一个面【该方法不带值检查】
+void RenderSystem::unrender_face(Block *block, int i)
+{
+    remove_renderable(&block->face_id[i]);
 }
 
 // 更新某个位置方块的面渲染状态
@@ -109,14 +153,18 @@ void RenderSystem::render_block(Block *block)
 {
     if (block == nullptr || block->kind == BLOCK_AIR)
         return;
+    if (CHUNK_MESHING)
+    { // 区块网格在下一帧整体重建
+        mark_block_dirty(block->pos);
+        return;
+    }
     // 【半透明方块】永远渲染全部六个面
     if (block->transparent)
     {
         for (int i = 0; i < 6; ++i)
         {
             render_face(block, i);
-            __renderables.push_back(block->faces[i]);
-            block->face_id[i] = __renderables.size() - 1;
+            add_renderable(block->faces[i], &block->face_id[i]);
         }
         return;
     }
@@ -129,8 +177,7 @@ void RenderSystem::render_block(Block *block)
             if (!near_block || near_block->kind == BLOCK_AIR)
             { // 没有方块邻近，渲染该面
                 render_face(block, i);
-                __renderables.push_back(block->faces[i]);
-                block->face_id[i] = __renderables.size() - 1;
+                add_renderable(block->faces[i], &block->face_id[i]);
             }
             else
             {                                     // 清除邻接方块不再暴露空气的面
@@ -146,6 +193,11 @@ void RenderSystem::unrender_block(glm::ivec3 pos)
     Block *block = get_block(pos);
     if (block == nullptr || block->kind == BLOCK_AIR)
         return;
+    if (CHUNK_MESHING)
+    { // 此时方块还没有被替换为空气，只标记区块，下一帧再重建网格
+        mark_block_dirty(pos);
+        return;
+    }
 
     // 将被拆除方块的6个面消除掉
     for (int i = 0; i < 6; ++i)
@@ -167,8 +219,7 @@ void RenderSystem::unrender_block(glm::ivec3 pos)
                 continue;
             int opp_i = 5 - i;
             render_face(near_block, opp_i);
-            __renderables.push_back(near_block->faces[opp_i]);
-            near_block->face_id[opp_i] = __renderables.size() - 1;
+            add_renderable(near_block->faces[opp_i], &near_block->face_id[opp_i]);
         }
     }
 }
@@ -187,6 +238,13 @@ void RenderSystem::render_chunk(int rx, int ry, int rz)
     {
         return; // 已经渲染过了
     }
+    if (CHUNK_MESHING)
+    {
+        request_chunk_mesh(chunk);
+        chunk->rendered = true;
+        __rendered_chunks.push_back(chunk);
+        return;
+    }
     for (int i = 0; i < CHUNK_LEN; ++i)
     {
         for (int j = 0; j < CHUNK_LEN; ++j)
@@ -210,6 +268,17 @@ void RenderSystem::unrender_chunk(Chunk *chunk)
     if (!chunk || !chunk->rendered)
         return;
     chunk->rendered = false;
+    if (CHUNK_MESHING)
+    {
+        ++chunk->mesh_version; // 还在后台网格化的结果作废
+        remove_renderable(&chunk->mesh_id);
+        retire_mesh(chunk->mesh);
+        chunk->mesh = nullptr;
+        remove_renderable(&chunk->translucent_mesh_id);
+        retire_mesh(chunk->translucent_mesh);
+        chunk->translucent_mesh = nullptr;
+        return;
+    }
     for (int i = 0; i < CHUNK_LEN; ++i)
     {
         for (int j = 0; j < CHUNK_LEN; ++j)
@@ -228,13 +297,157 @@ void RenderSystem::unrender_chunk(Chunk *chunk)
     }
 }
 
+// 在主线程立即重建区块的合并网格（方块编辑时使用，之前投递的后台任务作废）
+void RenderSystem::mesh_chunk(Chunk *chunk)
+{
+    ++chunk->mesh_version;
+    std::vector<ChunkQuad> quads, translucent_quads;
+    ChunkSnapshot snapshot;
+    snapshot_chunk(chunk, snapshot, &__lod_center);
+    mesh_snapshot_binary(snapshot, quads, &translucent_quads);
+    install_chunk_mesh(chunk, create_chunk_mesh(quads, false), create_chunk_mesh(translucent_quads, true));
+}
+
+// 投递到后台网格化线程，结果由apply_meshed_chunks换入；没有工作线程时直接网格化
+void RenderSystem::request_chunk_mesh(Chunk *chunk)
+{
+    if (!__mesh_workers.running())
+    {
+        mesh_chunk(chunk);
+        return;
+    }
+    ++chunk->mesh_version;
+    __mesh_workers.submit(chunk, __lod_center);
+}
+
+// 用新网格替换区块的旧网格（不透明和半透明两部分），半透明部分等待sort_translucent_chunks排序
+void RenderSystem::install_chunk_mesh(Chunk *chunk, Mesh *mesh, Mesh *translucent_mesh)
+{
+    place_chunk_mesh(chunk, chunk->mesh, chunk->mesh_id, mesh, CHUNK_MATERIAL);
+    place_chunk_mesh(chunk, chunk->translucent_mesh, chunk->translucent_mesh_id, translucent_mesh, CHUNK_TRANSLUCENT_MATERIAL);
+    chunk->translucent_sorted = false;
+}
+
+// 替换区块的一个网格及其在__renderables中的渲染对象；mesh为空表示这部分没有可见面
+void RenderSystem::place_chunk_mesh(Chunk *chunk, Mesh *&slot_mesh, int &slot_id, Mesh *mesh, Material *material)
+{
+    retire_mesh(slot_mesh);
+    slot_mesh = mesh;
+    if (!mesh)
+    {
+        remove_renderable(&slot_id);
+        return;
+    }
+    __pending_meshes.push_back(mesh);
+
+    RenderObject object;
+    object.mesh = mesh;
+    object.material = material;
+    object.pos = glm::ivec3(chunk->cx, chunk->cy, chunk->cz) * CHUNK_LEN;
+    object.face = OBJECT_FACE_NONE; // 只平移到区块原点，法线由顶点中的面索引决定
+    if (slot_id == FACE_UNRENDERED || slot_id >= __renderables.size())
+        add_renderable(object, &slot_id);
+    else
+    {
+        __renderables[slot_id] = object; // 原地替换，槽位不变
+        __dirty_renderables.push_back(slot_id);
+    }
+}
+
+// 换入后台线程完成的区块网格，每帧绘制前调用；过期的结果（区块之后又被修改或取消渲染）直接丢弃
+void RenderSystem::apply_meshed_chunks()
+{
+    static std::vector<MeshedChunk> results;
+    __mesh_workers.collect(results);
+    for (MeshedChunk &result : results)
+    {
+        if (!result.chunk->rendered || result.version != result.chunk->mesh_version)
+        {
+            delete result.mesh;
+            delete result.translucent_mesh;
+            continue;
+        }
+        install_chunk_mesh(result.chunk, result.mesh, result.translucent_mesh);
+    }
+}
+
+// 相机移动超过TRANSLUCENT_RESORT_DISTANCE时，把半透明网格按从远到近重新排序；只改索引，已上传的网格交给VenomApp上传新索引
+void RenderSystem::sort_translucent_chunks(glm::vec3 camera_pos)
+{
+    for (Chunk *chunk : __rendered_chunks)
+    {
+        Mesh *mesh = chunk->translucent_mesh;
+        if (!mesh)
+            continue;
+        if (chunk->translucent_sorted && glm::distance(camera_pos, chunk->sort_camera_pos) < TRANSLUCENT_RESORT_DISTANCE)
+            continue;
+        chunk->translucent_sorted = true;
+        chunk->sort_camera_pos = camera_pos;
+        sort_translucent_quads(mesh, camera_pos - glm::vec3(chunk->cx, chunk->cy, chunk->cz) * (float)CHUNK_LEN);
+        bool pending = std::find(__pending_meshes.begin(), __pending_meshes.end(), mesh) != __pending_meshes.end();
+        bool resorted = std::find(__resorted_meshes.begin(), __resorted_meshes.end(), mesh) != __resorted_meshes.end();
+        if (!pending && !resorted)
+            __resorted_meshes.push_back(mesh);
+    }
+}
+
+// 标记方块所在区块（以及方块位于区块边界时相邻的区块）需要重建网格
+void RenderSystem::mark_block_dirty(glm::ivec3 pos)
+{
+    for (int i = -1; i < 6; ++i)
+    {
+        glm::ivec3 near_pos = i < 0 ? pos : pos + BLOCK_DIR[i];
+        if (near_pos.x < 0 || near_pos.y < 0 || near_pos.z < 0)
+            continue;
+        Chunk *chunk = get_chunk(near_pos.x / CHUNK_LEN, near_pos.y / CHUNK_LEN, near_pos.z / CHUNK_LEN);
+        if (!chunk || !chunk->rendered || chunk->dirty)
+            continue;
+        chunk->dirty = true;
+        __dirty_chunks.push_back(chunk);
+    }
+}
+
+// 重建被标记的区块网格，每帧绘制前调用；离玩家近的区块优先，每帧最多CHUNK_REMESH_PER_FRAME个，避免大量编辑时卡顿
+void RenderSystem::update_dirty_chunks(glm::vec3 player_pos)
+{
+    if (__dirty_chunks.empty())
+        return;
+    glm::vec3 player_chunk = player_pos / (float)CHUNK_LEN - 0.5f; // 与区块中心比较
+    auto distance = [&](const Chunk *chunk)
+    {
+        glm::vec3 d = glm::vec3(chunk->cx, chunk->cy, chunk->cz) - player_chunk;
+        return glm::dot(d, d);
+    };
+    int count = std::min((int)__dirty_chunks.size(), CHUNK_REMESH_PER_FRAME);
+    std::partial_sort(__dirty_chunks.begin(), __dirty_chunks.begin() + count, __dirty_chunks.end(),
+                      [&](const Chunk *a, const Chunk *b)
+                      { return distance(a) < distance(b); });
+    for (int i = 0; i < count; ++i)
+    {
+        Chunk *chunk = __dirty_chunks[i];
+        chunk->dirty = false;
+        if (chunk->rendered)
+            mesh_chunk(chunk);
+    }
+    __dirty_chunks.erase(__dirty_chunks.begin(), __dirty_chunks.begin() + count);
+}
+
 // 重新渲染玩家【附近】所有区块
 void RenderSystem::render_all_chunks(glm::vec3 player_pos, bool rerender)
 {
+    for (int *owner : __renderable_owners)
+    {
+        if (owner)
+            *owner = FACE_UNRENDERED;
+    }
     std::vector<RenderObject>().swap(__renderables); // 清空并释放所有空间
+    __renderable_owners.clear();
+    __free_renderables.clear();
+    __dirty_renderables.clear(); // 之后放入的对象重新标记
     int rx = (int)player_pos.x / CHUNK_LEN;
     int ry = (int)player_pos.y / CHUNK_LEN;
     int rz = (int)player_pos.z / CHUNK_LEN;
+    __lod_center = glm::ivec3(rx, ry, rz);
 
     // 先自然生成区块
     if (!rerender)
@@ -265,10 +478,40 @@ void RenderSystem::render_all_chunks(glm::vec3 player_pos, bool rerender)
     }
 }
 
+// 细节层次中心移动后，重新网格化层次变化的区块，以及与它们相邻的区块（交界面的封闭方式随之改变）
+void RenderSystem::update_chunk_lods(glm::ivec3 center)
+{
+    glm::ivec3 last_center = __lod_center;
+    __lod_center = center;
+    std::vector<Chunk *> changed;
+    for (Chunk *chunk : __rendered_chunks)
+    {
+        glm::ivec3 cpos(chunk->cx, chunk->cy, chunk->cz);
+        if (chunk_lod_scale(cpos, last_center) == chunk_lod_scale(cpos, center))
+            continue;
+        changed.push_back(chunk);
+        for (int i = 0; i < 6; ++i)
+        {
+            glm::ivec3 near_cpos = cpos + BLOCK_DIR[i];
+            if (near_cpos.x < 0 || near_cpos.y < 0 || near_cpos.z < 0)
+                continue;
+            Chunk *near_chunk = get_chunk(near_cpos.x, near_cpos.y, near_cpos.z);
+            if (near_chunk && near_chunk->rendered)
+                changed.push_back(near_chunk);
+        }
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    for (Chunk *chunk : changed)
+        request_chunk_mesh(chunk);
+}
+
 // 玩家移动时导致区块更新（懒删除离开方向的区块，勤加载前进方向的区块）
 void RenderSystem::update_render_chunks(glm::ivec3 chunk_pos, glm::vec3 player_pos)
 {
     int chunk_x = chunk_pos.x, chunk_y = chunk_pos.y, chunk_z = chunk_pos.z;
+    if (CHUNK_MESHING)
+        update_chunk_lods(chunk_pos); // 先更新细节层次中心，之后新渲染的区块直接按新的层次网格化
     // 以玩家为中心圆，渲染新区块
     for (int i = chunk_x - CHUNK_RENDER_RADIUS; i <= chunk_x + CHUNK_RENDER_RADIUS; ++i)
     {
@@ -282,20 +525,6 @@ void RenderSystem::update_render_chunks(glm::ivec3 chunk_pos, glm::vec3 player_p
         }
     }
 
-    // 面数太多，重载
-    if (__renderables.size() > REFRESH_RENDER_FACE_MAX)
-    {
-        for (int i = 0; i < __rendered_chunks.size(); ++i)
-        {
-            unrender_chunk(__rendered_chunks[i]);
-        }
-        //            vector<Chunk*>().swap(__rendered_chunks); // 清空并释放所有空间
-        __rendered_chunks.clear(); // 【不应该释放这些空间？】
-        render_all_chunks(player_pos, true);
-        printf("__renderables overflow, refreshing...");
-        return;
-    }
-
     // 懒删除：检查已经渲染的区块数量有多少，超过上限就清理所有超出范围的区块
     if (__rendered_chunks.size() > CHUNK_RENDER_COUNT_MAX)
     {
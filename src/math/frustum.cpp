@@ -0,0 +1,94 @@
+#include "frustum.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+Frustum extract_frustum(const glm::mat4 &view_proj)
+{
+    // glm按列存储，第i行为(m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i)
+        row[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+    Frustum frustum;
+    frustum.planes[0] = row[3] + row[0]; // 左
+    frustum.planes[1] = row[3] - row[0]; // 右
+    frustum.planes[2] = row[3] + row[1]; // 下
+    frustum.planes[3] = row[3] - row[1]; // 上
+    frustum.planes[4] = row[3] + row[2]; // 近
+    frustum.planes[5] = row[3] - row[2]; // 远
+    return frustum;
+}
+
+void AABBBatch::clear()
+{
+    for (int a = 0; a < 3; ++a)
+    {
+        _min[a].clear();
+        _max[a].clear();
+    }
+    _size = 0;
+}
+
+void AABBBatch::push(glm::vec3 min, glm::vec3 max)
+{
+    if (_size % FRUSTUM_BATCH == 0)
+    { // 新开一批，空位填0，结果不使用
+        for (int a = 0; a < 3; ++a)
+        {
+            _min[a].resize(_size + FRUSTUM_BATCH, 0.f);
+            _max[a].resize(_size + FRUSTUM_BATCH, 0.f);
+        }
+    }
+    for (int a = 0; a < 3; ++a)
+    {
+        _min[a][_size] = min[a];
+        _max[a][_size] = max[a];
+    }
+    ++_size;
+}
+
+size_t AABBBatch::cull(const Frustum &frustum, std::vector<uint8_t> &visible) const
+{
+    visible.resize(_min[0].size());
+    size_t count = 0;
+    for (size_t i = 0; i < _min[0].size(); i += FRUSTUM_BATCH)
+    {
+#ifdef FRUSTUM_SSE
+        __m128 min_x = _mm_loadu_ps(&_min[0][i]), min_y = _mm_loadu_ps(&_min[1][i]), min_z = _mm_loadu_ps(&_min[2][i]);
+        __m128 max_x = _mm_loadu_ps(&_max[0][i]), max_y = _mm_loadu_ps(&_max[1][i]), max_z = _mm_loadu_ps(&_max[2][i]);
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4 &plane : frustum.planes)
+        {
+            __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+            // 每个轴取min、max中在法线方向上更远的一个，相加即最远角点到平面的（未归一化）距离
+            __m128 distance = _mm_add_ps(_mm_max_ps(_mm_mul_ps(nx, min_x), _mm_mul_ps(nx, max_x)),
+                                         _mm_add_ps(_mm_max_ps(_mm_mul_ps(ny, min_y), _mm_mul_ps(ny, max_y)),
+                                                    _mm_max_ps(_mm_mul_ps(nz, min_z), _mm_mul_ps(nz, max_z))));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, _mm_set1_ps(plane.w)), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < FRUSTUM_BATCH; ++k)
+            visible[i + k] = !(mask >> k & 1);
+#else
+        for (int k = 0; k < FRUSTUM_BATCH; ++k)
+        {
+            size_t j = i + k;
+            bool outside = false;
+            for (const glm::vec4 &plane : frustum.planes)
+            {
+                float distance = glm::max(plane.x * _min[0][j], plane.x * _max[0][j]) +
+                                 glm::max(plane.y * _min[1][j], plane.y * _max[1][j]) +
+                                 glm::max(plane.z * _min[2][j], plane.z * _max[2][j]);
+                outside |= distance + plane.w < 0.f;
+            }
+            visible[j] = !outside;
+        }
+#endif
+    }
+    visible.resize(_size);
+    for (size_t i = 0; i < _size; ++i)
+        count += visible[i];
+    return count;
+}
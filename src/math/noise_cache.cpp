@@ -0,0 +1,49 @@
+#include "noise_cache.h"
+#include <cstring>
+#include <cstdio>
+
+NoiseTileCache &noise_tile_cache()
+{
+    static thread_local NoiseTileCache cache;
+    return cache;
+}
+
+// 未命中上次访问的块时查表，找不到则新建块并按LRU淘汰
+NoiseTile *NoiseTileCache::find_tile(glm::ivec2 tile_pos)
+{
+    auto it = _index.find(tile_pos);
+    if (it != _index.end())
+    {
+        _tiles.splice(_tiles.begin(), _tiles, it->second); // 移到表头
+        return &_tiles.front();
+    }
+
+    if (_tiles.size() >= NOISE_TILE_CACHE_MAX)
+    {
+        _index.erase(_tiles.back().tile_pos);
+        _tiles.pop_back();
+        ++stats.evictions;
+    }
+    _tiles.emplace_front();
+    NoiseTile &tile = _tiles.front();
+    tile.tile_pos = tile_pos;
+    memset(tile.ready, 0, sizeof(tile.ready));
+    _index[tile_pos] = _tiles.begin();
+    ++stats.tile_loads;
+    return &tile;
+}
+
+void NoiseTileCache::clear()
+{
+    _tiles.clear();
+    _index.clear();
+    _last = nullptr;
+    stats = NoiseCacheStats();
+}
+
+void NoiseTileCache::print_stats() const
+{
+    printf("noise tile cache: hit rate %.2f%% (%llu hits, %llu misses), %llu tiles loaded, %llu evicted, %zu resident\n",
+           stats.hit_rate() * 100, (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+           (unsigned long long)stats.tile_loads, (unsigned long long)stats.evictions, _tiles.size());
+}
@@ -0,0 +1,546 @@
+#include "noise_graph.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NOISE_GRAPH_SSE 1
+#endif
+
+// 内容相同的节点只保留一个（公共子表达式消除）
+int NoiseGraph::make_node(const NoiseNode &node)
+{
+    auto key = std::make_tuple((int)node.op, node.a, node.b, node.value, node.offset.x, node.offset.y, node.divisor);
+    auto it = _node_ids.find(key);
+    if (it != _node_ids.end())
+        return it->second;
+    _nodes.push_back(node);
+    return _node_ids[key] = _nodes.size() - 1;
+}
+
+// 常量折叠和代数化简，化简结果与逐列标量计算逐位相同
+int NoiseGraph::fold(NOISE_OP op, int a, int b)
+{
+    bool const_a = _nodes[a].op == NOISE_CONST;
+    bool const_b = b < 0 || _nodes[b].op == NOISE_CONST;
+    if (const_a && const_b)
+    {
+        float x = _nodes[a].value, y = b < 0 ? 0 : _nodes[b].value;
+        switch (op)
+        {
+        case NOISE_ADD:
+            return constant(x + y);
+        case NOISE_SUB:
+            return constant(x - y);
+        case NOISE_MUL:
+            return constant(x * y);
+        case NOISE_DIV:
+            return constant(x / y);
+        case NOISE_POW:
+            return constant(std::pow(x, y));
+        case NOISE_ABS:
+            return constant(std::abs(x));
+        default:
+            break;
+        }
+    }
+    switch (op)
+    {
+    case NOISE_ADD:
+        if (is_const(a, 0))
+            return b;
+        if (is_const(b, 0))
+            return a;
+        break;
+    case NOISE_SUB:
+        if (is_const(b, 0))
+            return a;
+        break;
+    case NOISE_MUL:
+        if (is_const(a, 0) || is_const(b, 0))
+            return constant(0); // 权重为0的噪声整条分支都不再求值
+        if (is_const(a, 1))
+            return b;
+        if (is_const(b, 1))
+            return a;
+        break;
+    case NOISE_DIV:
+        if (is_const(b, 1))
+            return a;
+        break;
+    case NOISE_POW:
+        if (is_const(b, 1))
+            return a;
+        if (is_const(b, 0))
+            return constant(1);
+        break;
+    default:
+        break;
+    }
+    NoiseNode node;
+    node.op = op;
+    node.a = a;
+    node.b = b;
+    return make_node(node);
+}
+
+int NoiseGraph::constant(float value)
+{
+    NoiseNode node;
+    node.op = NOISE_CONST;
+    node.value = value;
+    return make_node(node);
+}
+
+int NoiseGraph::input(const std::string &name)
+{
+    int slot = input_slot(name);
+    if (slot < 0)
+    {
+        slot = _input_names.size();
+        _input_names.push_back(name);
+    }
+    NoiseNode node;
+    node.op = NOISE_INPUT;
+    node.value = slot;
+    return make_node(node);
+}
+
+int NoiseGraph::perlin(glm::vec2 offset, float divisor)
+{
+    NoiseNode node;
+    node.op = NOISE_PERLIN;
+    node.offset = offset;
+    node.divisor = divisor;
+    return make_node(node);
+}
+
+int NoiseGraph::worley(glm::vec2 offset, float divisor)
+{
+    NoiseNode node;
+    node.op = NOISE_WORLEY;
+    node.offset = offset;
+    node.divisor = divisor;
+    return make_node(node);
+}
+
+int NoiseGraph::fbm(glm::vec2 offset, float divisor)
+{
+    NoiseNode node;
+    node.op = NOISE_FBM;
+    node.offset = offset;
+    node.divisor = divisor;
+    return make_node(node);
+}
+
+void NoiseGraph::set_output(int node)
+{
+    _output = node;
+    // 节点编号天然是拓扑序（操作数总是先于结果创建），标记输出可达的节点即可
+    std::vector<bool> live(_nodes.size(), false);
+    live[node] = true;
+    for (int i = node; i >= 0; --i)
+    {
+        if (!live[i])
+            continue;
+        if (_nodes[i].a >= 0)
+            live[_nodes[i].a] = true;
+        if (_nodes[i].b >= 0)
+            live[_nodes[i].b] = true;
+    }
+    _program.clear();
+    for (int i = 0; i <= node; ++i)
+        if (live[i])
+            _program.push_back(i);
+}
+
+int NoiseGraph::input_slot(const std::string &name) const
+{
+    for (size_t i = 0; i < _input_names.size(); ++i)
+        if (_input_names[i] == name)
+            return (int)i;
+    return -1;
+}
+
+uint64_t NoiseGraph::fingerprint() const
+{
+    uint64_t hash = fnv1a_hash(&_output, sizeof(_output));
+    for (const std::string &name : _input_names)
+        hash = fnv1a_hash(name.c_str(), name.size() + 1, hash);
+    for (int id : _program)
+    {
+        const NoiseNode &node = _nodes[id];
+        int32_t op = node.op;
+        float params[4] = {node.value, node.offset.x, node.offset.y, node.divisor};
+        hash = fnv1a_hash(&id, sizeof(id), hash);
+        hash = fnv1a_hash(&op, sizeof(op), hash);
+        hash = fnv1a_hash(&node.a, sizeof(node.a), hash);
+        hash = fnv1a_hash(&node.b, sizeof(node.b), hash);
+        hash = fnv1a_hash(params, sizeof(params), hash);
+    }
+    return hash;
+}
+
+bool NoiseGraph::load_from_file(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::string line;
+    int line_no = 0;
+    while (std::getline(file, line))
+    {
+        ++line_no;
+        std::istringstream in(line);
+        std::string name, eq, op;
+        if (!(in >> name) || name[0] == '#')
+            continue;
+        if (name == "output")
+        {
+            std::string out;
+            in >> out;
+            if (!_named.count(out))
+            {
+                printf("Noise graph %s:%d: unknown node %s\n", path.c_str(), line_no, out.c_str());
+                return false;
+            }
+            set_output(_named[out]);
+            continue;
+        }
+        if (!(in >> eq >> op) || eq != "=")
+        {
+            printf("Noise graph %s:%d: expected \"name = op args...\"\n", path.c_str(), line_no);
+            return false;
+        }
+        std::vector<std::string> args;
+        std::string arg;
+        while (in >> arg && arg[0] != '#')
+            args.push_back(arg);
+
+        // 参数可以是已定义的名字或数值
+        bool ok = true;
+        auto operand = [&](size_t i) -> int
+        {
+            if (i >= args.size())
+            {
+                ok = false;
+                return 0;
+            }
+            auto it = _named.find(args[i]);
+            if (it != _named.end())
+                return it->second;
+            char *end;
+            float value = strtof(args[i].c_str(), &end);
+            if (*end)
+            {
+                ok = false;
+                return 0;
+            }
+            return constant(value);
+        };
+        auto number = [&](size_t i) -> float
+        {
+            if (i >= args.size())
+            {
+                ok = false;
+                return 0;
+            }
+            char *end;
+            float value = strtof(args[i].c_str(), &end);
+            if (*end)
+                ok = false;
+            return value;
+        };
+
+        int id = -1;
+        if (op == "const")
+            id = constant(number(0));
+        else if (op == "input")
+            id = input(name);
+        else if (op == "add")
+            id = operand(0), id = ok ? add(id, operand(1)) : id;
+        else if (op == "sub")
+            id = operand(0), id = ok ? sub(id, operand(1)) : id;
+        else if (op == "mul")
+            id = operand(0), id = ok ? mul(id, operand(1)) : id;
+        else if (op == "div")
+            id = operand(0), id = ok ? div(id, operand(1)) : id;
+        else if (op == "pow")
+            id = operand(0), id = ok ? pow(id, operand(1)) : id;
+        else if (op == "abs")
+            id = operand(0), id = ok ? abs(id) : id;
+        else if (op == "perlin" || op == "worley" || op == "fbm")
+        {
+            glm::vec2 offset(number(0), number(1));
+            float divisor = number(2);
+            if (!(divisor > 0))
+                ok = false; // 除数为0、负数或NaN时整片地形都是inf/NaN
+            else if (ok)
+                id = op == "perlin" ? perlin(offset, divisor) : op == "worley" ? worley(offset, divisor) : fbm(offset, divisor);
+        }
+        else
+            ok = false;
+        if (!ok)
+        {
+            printf("Noise graph %s:%d: bad operation \"%s\"\n", path.c_str(), line_no, line.c_str());
+            return false;
+        }
+        _named[name] = id;
+    }
+    return _output >= 0;
+}
+
+#ifdef NOISE_GRAPH_SSE
+// 逐元素运算，每次4列
+template <typename Op>
+static inline void map_ps(int lanes, float *r, const float *ra, const float *rb, Op op)
+{
+    for (int i = 0; i < lanes; i += 4)
+        _mm_storeu_ps(r + i, op(_mm_loadu_ps(ra + i), _mm_loadu_ps(rb + i)));
+}
+
+static inline __m128 abs_ps(__m128 x)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+// SSE2没有取整指令，截断后把大于x的结果减1
+static inline __m128 floor_ps(__m128 x)
+{
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+}
+
+// 第i列起4列的噪声采样坐标(xz + offset) / divisor，超出n的列重复最后一列
+static inline void load_uv(const glm::vec2 *xz, int n, int i, const NoiseNode &node, __m128 &u, __m128 &v)
+{
+    alignas(16) float x[4], z[4];
+    for (int k = 0; k < 4; ++k)
+    {
+        const glm::vec2 &p = xz[std::min(i + k, n - 1)];
+        x[k] = p.x;
+        z[k] = p.y;
+    }
+    __m128 divisor = _mm_set1_ps(node.divisor);
+    u = _mm_div_ps(_mm_add_ps(_mm_load_ps(x), _mm_set1_ps(node.offset.x)), divisor);
+    v = _mm_div_ps(_mm_add_ps(_mm_load_ps(z), _mm_set1_ps(node.offset.y)), divisor);
+}
+
+// surflet的衰减1 - 6d^5 + 15d^4 - 10d^3（标量版本用double的pow计算）
+static inline __m128 surflet_falloff_ps(__m128 d)
+{
+    __m128 d3 = _mm_mul_ps(_mm_mul_ps(d, d), d);
+    __m128 poly = _mm_sub_ps(_mm_set1_ps(10.f), _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(15.f), _mm_mul_ps(_mm_set1_ps(6.f), d))));
+    return _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(d3, poly));
+}
+
+// smoothing(a, b, t)：五次插值系数加glm::mix
+static inline __m128 smoothing_ps(__m128 a, __m128 b, __m128 t)
+{
+    t = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t),
+                   _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f)));
+    return _mm_add_ps(_mm_mul_ps(a, _mm_sub_ps(_mm_set1_ps(1.f), t)), _mm_mul_ps(b, t));
+}
+
+// 以下与noise_cache.h中的同名函数相同，4列一起计算，格点哈希仍逐列从缓存读取
+
+static inline __m128 perlin_ps(NoiseTileCache &cache, __m128 u, __m128 v)
+{
+    __m128 fu = floor_ps(u), fv = floor_ps(v);
+    alignas(16) int ix[4], iy[4];
+    _mm_store_si128((__m128i *)ix, _mm_cvttps_epi32(fu));
+    _mm_store_si128((__m128i *)iy, _mm_cvttps_epi32(fv));
+    static const int corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}}; // 与perlinNoiseCached的求和顺序相同
+    __m128 sum = _mm_setzero_ps();
+    for (const int *corner : corners)
+    {
+        alignas(16) float gx[4], gy[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            vec2 g = cache.gradient(ix[k] + corner[0], iy[k] + corner[1]);
+            gx[k] = g.x;
+            gy[k] = g.y;
+        }
+        __m128 dx = _mm_sub_ps(u, _mm_add_ps(fu, _mm_set1_ps((float)corner[0])));
+        __m128 dy = _mm_sub_ps(v, _mm_add_ps(fv, _mm_set1_ps((float)corner[1])));
+        __m128 height = _mm_add_ps(_mm_mul_ps(dx, _mm_load_ps(gx)), _mm_mul_ps(dy, _mm_load_ps(gy)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_mul_ps(height, surflet_falloff_ps(abs_ps(dx))), surflet_falloff_ps(abs_ps(dy))));
+    }
+    return sum;
+}
+
+static inline __m128 worley_ps(NoiseTileCache &cache, __m128 u, __m128 v)
+{
+    __m128 fu = floor_ps(u), fv = floor_ps(v);
+    __m128 frac_u = _mm_sub_ps(u, fu), frac_v = _mm_sub_ps(v, fv);
+    alignas(16) int ix[4], iy[4];
+    _mm_store_si128((__m128i *)ix, _mm_cvttps_epi32(fu));
+    _mm_store_si128((__m128i *)iy, _mm_cvttps_epi32(fv));
+    __m128 min_dist = _mm_set1_ps(1.f);
+    for (int y = -1; y <= 1; y++)
+        for (int x = -1; x <= 1; x++)
+        {
+            alignas(16) float px[4], py[4];
+            for (int k = 0; k < 4; ++k)
+            {
+                vec2 point = cache.gradient(ix[k] + x, iy[k] + y);
+                px[k] = point.x;
+                py[k] = point.y;
+            }
+            __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)x), _mm_load_ps(px)), frac_u);
+            __m128 dy = _mm_sub_ps(_mm_add_ps(_mm_set1_ps((float)y), _mm_load_ps(py)), frac_v);
+            min_dist = _mm_min_ps(min_dist, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+        }
+    return min_dist;
+}
+
+static inline __m128 fbm_ps(NoiseTileCache &cache, __m128 u, __m128 v)
+{
+    __m128 total = _mm_setzero_ps();
+    float freq = 4.f, amp = 0.5f;
+    for (int octave = 1; octave <= 6; octave++)
+    {
+        __m128 x = _mm_mul_ps(u, _mm_set1_ps(freq)), y = _mm_mul_ps(v, _mm_set1_ps(freq));
+        __m128 fx = floor_ps(x), fy = floor_ps(y);
+        alignas(16) int ix[4], iy[4];
+        _mm_store_si128((__m128i *)ix, _mm_cvttps_epi32(fx));
+        _mm_store_si128((__m128i *)iy, _mm_cvttps_epi32(fy));
+        alignas(16) float v1[4], v2[4], v3[4], v4[4];
+        for (int k = 0; k < 4; ++k)
+        {
+            v1[k] = cache.value(ix[k], iy[k]);
+            v2[k] = cache.value(ix[k] + 1, iy[k]);
+            v3[k] = cache.value(ix[k], iy[k] + 1);
+            v4[k] = cache.value(ix[k] + 1, iy[k] + 1);
+        }
+        __m128 frac_x = _mm_sub_ps(x, fx), frac_y = _mm_sub_ps(y, fy);
+        __m128 i1 = smoothing_ps(_mm_load_ps(v1), _mm_load_ps(v2), frac_x);
+        __m128 i2 = smoothing_ps(_mm_load_ps(v3), _mm_load_ps(v4), frac_x);
+        total = _mm_add_ps(total, _mm_mul_ps(smoothing_ps(i1, i2, frac_y), _mm_set1_ps(amp)));
+        freq *= 2.f;
+        amp *= 0.5f;
+    }
+    return total;
+}
+#endif
+
+void NoiseGraph::evaluate(const glm::vec2 *xz, int n, const float *const *inputs, float *out) const
+{
+    // 每个节点一段寄存器，缓冲按线程复用，不在每次求值时分配
+    static thread_local std::vector<float> regs;
+    if (regs.size() < _nodes.size() * BATCH_MAX)
+        regs.resize(_nodes.size() * BATCH_MAX);
+#ifdef NOISE_GRAPH_SSE
+    NoiseTileCache &cache = noise_tile_cache();
+    int lanes = (n + 3) & ~3; // 补齐到4的倍数，多出的列只在寄存器中，不会输出
+#endif
+    for (int id : _program)
+    {
+        const NoiseNode &node = _nodes[id];
+        float *r = &regs[id * BATCH_MAX];
+        const float *ra = node.a >= 0 ? &regs[node.a * BATCH_MAX] : nullptr;
+        const float *rb = node.b >= 0 ? &regs[node.b * BATCH_MAX] : nullptr;
+        switch (node.op)
+        {
+        case NOISE_CONST:
+#ifdef NOISE_GRAPH_SSE
+            for (int i = 0; i < lanes; i += 4)
+                _mm_storeu_ps(r + i, _mm_set1_ps(node.value));
+#else
+            for (int i = 0; i < n; ++i)
+                r[i] = node.value;
+#endif
+            break;
+        case NOISE_INPUT:
+        {
+            const float *in = inputs[(int)node.value];
+            for (int i = 0; i < n; ++i)
+                r[i] = in[i];
+#ifdef NOISE_GRAPH_SSE
+            for (int i = n; i < lanes; ++i)
+                r[i] = 0;
+#endif
+            break;
+        }
+#ifdef NOISE_GRAPH_SSE
+        // 单精度加减乘除和取绝对值与标量计算逐位相同
+        case NOISE_ADD:
+            map_ps(lanes, r, ra, rb, [](__m128 a, __m128 b) { return _mm_add_ps(a, b); });
+            break;
+        case NOISE_SUB:
+            map_ps(lanes, r, ra, rb, [](__m128 a, __m128 b) { return _mm_sub_ps(a, b); });
+            break;
+        case NOISE_MUL:
+            map_ps(lanes, r, ra, rb, [](__m128 a, __m128 b) { return _mm_mul_ps(a, b); });
+            break;
+        case NOISE_DIV:
+            map_ps(lanes, r, ra, rb, [](__m128 a, __m128 b) { return _mm_div_ps(a, b); });
+            break;
+        case NOISE_POW:
+            for (int i = 0; i < lanes; ++i)
+                r[i] = std::pow(ra[i], rb[i]);
+            break;
+        case NOISE_ABS:
+            map_ps(lanes, r, ra, ra, [](__m128 a, __m128) { return abs_ps(a); });
+            break;
+        case NOISE_PERLIN:
+        case NOISE_WORLEY:
+        case NOISE_FBM:
+            for (int i = 0; i < lanes; i += 4)
+            {
+                __m128 u, v;
+                load_uv(xz, n, i, node, u, v);
+                __m128 value = node.op == NOISE_PERLIN   ? perlin_ps(cache, u, v)
+                               : node.op == NOISE_WORLEY ? worley_ps(cache, u, v)
+                                                         : fbm_ps(cache, u, v);
+                _mm_storeu_ps(r + i, value);
+            }
+            break;
+#else
+        case NOISE_ADD:
+            for (int i = 0; i < n; ++i)
+                r[i] = ra[i] + rb[i];
+            break;
+        case NOISE_SUB:
+            for (int i = 0; i < n; ++i)
+                r[i] = ra[i] - rb[i];
+            break;
+        case NOISE_MUL:
+            for (int i = 0; i < n; ++i)
+                r[i] = ra[i] * rb[i];
+            break;
+        case NOISE_DIV:
+            for (int i = 0; i < n; ++i)
+                r[i] = ra[i] / rb[i];
+            break;
+        case NOISE_POW:
+            for (int i = 0; i < n; ++i)
+                r[i] = std::pow(ra[i], rb[i]);
+            break;
+        case NOISE_ABS:
+            for (int i = 0; i < n; ++i)
+                r[i] = std::abs(ra[i]);
+            break;
+        case NOISE_PERLIN:
+            for (int i = 0; i < n; ++i)
+                r[i] = perlinNoiseCached((xz[i] + node.offset) / node.divisor);
+            break;
+        case NOISE_WORLEY:
+            for (int i = 0; i < n; ++i)
+                r[i] = worleyNoiseCached((xz[i] + node.offset) / node.divisor);
+            break;
+        case NOISE_FBM:
+            for (int i = 0; i < n; ++i)
+                r[i] = fbmCached((xz[i] + node.offset) / node.divisor);
+            break;
+#endif
+        }
+    }
+    const float *result = &regs[_output * BATCH_MAX];
+    for (int i = 0; i < n; ++i)
+        out[i] = result[i];
+}
@@ -1,5 +1,6 @@
 #include "vk_engine.h"
 #include <string>
+#include <tuple>
 
 #define VMA_IMPLEMENTATION
 #include <vma/vk_mem_alloc.h>
@@ -35,12 +36,9 @@ void VenomApp::resize_swapchain()
     _resize_requested = false;
 }
 
-// 类似于drawcall，提交立即执行的CPU复制缓冲指令到buffer，然后提交到graphics queue（可以提交到另外的计算专用Queue执行，实现后台线程计算）
+// 类似于drawcall，录制一次性的指令提交到graphics queue并等待执行完成；只用于初始化时的图像布局转换，网格和纹理数据由_uploader异步上传
 void VenomApp::immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function)
 {
-    vkWaitForFences(_device, 1, &_upload_context._uploadFence, true, 9999999999);
-    vkResetFences(_device, 1, &_upload_context._uploadFence);
-
     VkCommandBuffer cmd = _upload_context._commandBuffer;
     // begin the command buffer recording. We will use this command buffer exactly once before resetting, so we tell vulkan that
     VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
@@ -54,8 +52,9 @@ void VenomApp::immediate_submit(std::function<void(VkCommandBuffer cmd)> &&funct
     // submit command buffer to the queue and execute it.
     //  _uploadFence will now block until the graphic commands finish execution
     VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, _upload_context._uploadFence));
+    VK_CHECK(vkWaitForFences(_device, 1, &_upload_context._uploadFence, true, UINT64_MAX));
+    VK_CHECK(vkResetFences(_device, 1, &_upload_context._uploadFence));
     // reset the command buffers inside the command pool
-    vkQueueWaitIdle(_graphics_queue);
     vkResetCommandPool(_device, _upload_context._commandPool, 0);
 }
 
@@ -72,7 +71,8 @@ size_t VenomApp::pad_uniform_buffer_size(size_t originalSize)
     return alignedSize;
 }
 
-AllocatedBuffer VenomApp::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+// mapped为真时缓冲在整个生命周期内保持映射（_mapped），每帧直接写入，不再反复vmaMapMemory/vmaUnmapMemory
+AllocatedBuffer VenomApp::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, bool mapped)
 {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -80,19 +80,50 @@ AllocatedBuffer VenomApp::create_buffer(size_t allocSize, VkBufferUsageFlags usa
 
     bufferInfo.size = allocSize;
     bufferInfo.usage = usage;
+    // 上传队列在另一个队列簇时，接收复制的缓冲由两个队列簇共享，省去队列簇所有权转移
+    uint32_t queueFamilies[] = {_graphics_queue_family, _upload_queue_family};
+    if ((usage & VK_BUFFER_USAGE_TRANSFER_DST_BIT) && _upload_queue_family != _graphics_queue_family)
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
 
     VmaAllocationCreateInfo vmaallocInfo = {};
     vmaallocInfo.usage = memoryUsage;
+    if (mapped)
+        vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
     AllocatedBuffer newBuffer;
+    VmaAllocationInfo allocationInfo;
 
     VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &vmaallocInfo,
                              &newBuffer._buffer,
                              &newBuffer._allocation,
-                             nullptr));
+                             &allocationInfo));
+    if (mapped)
+        newBuffer._mapped = allocationInfo.pMappedData;
     return newBuffer;
 }
 
+// 写入持久映射缓冲的一段区域并刷新（内存不是HOST_COHERENT时才有实际开销），计入本帧上传字节数
+void VenomApp::write_mapped(const AllocatedBuffer &buffer, size_t offset, const void *src, size_t size)
+{
+    memcpy((char *)buffer._mapped + offset, src, size);
+    vmaFlushAllocation(_allocator, buffer._allocation, offset, size);
+    _frame_stats.upload_bytes += size;
+}
+
+// 只有value与上次写入该区域的内容不同才写入
+template <typename T>
+void VenomApp::write_mapped_if_changed(const AllocatedBuffer &buffer, size_t offset, const T &value, std::optional<T> &uploaded)
+{
+    if (uploaded && memcmp(&*uploaded, &value, sizeof(T)) == 0)
+        return;
+    write_mapped(buffer, offset, &value, sizeof(T));
+    uploaded = value;
+}
+
 // 当前要渲染的帧
 FrameData &VenomApp::get_current_frame()
 {
@@ -111,53 +142,56 @@ void VenomApp::load_texture()
     _loaded_textures["minecraft"] = tex;
 }
 
-// 【开放接口】创建网格单元并上传，该顺序不能改：直接定义或从obj文件读取网格顶点->通过顶点缓冲区上传到显存->提供给场景管理器用于绑定渲染对象
+// 把常驻网格的顶点追加到静态几何数据末尾（按Vertex大小对齐，绑定偏移为0时仍能用vertexOffset定位），记录起始顶点
+static void append_static_mesh(std::vector<char> &geometry, Mesh &mesh)
+{
+    size_t offset = (geometry.size() + sizeof(Vertex) - 1) / sizeof(Vertex) * sizeof(Vertex);
+    size_t size = mesh._vertices.size() * sizeof(Vertex);
+    geometry.resize(offset + size);
+    memcpy(geometry.data() + offset, mesh._vertices.data(), size);
+    mesh._static_offset = offset / sizeof(Vertex);
+}
+
+// 【开放接口】创建网格单元并上传，该顺序不能改：直接定义或从obj文件读取网格顶点->追加到静态几何->一次上传到显存->提供给场景管理器用于绑定渲染对象
 void VenomApp::load_meshes()
 {
-    int isMac = 0;
-    // #ifdef __APPLE__
-    //     isMac = 1;
-    //     Mesh air_mesh; //【macOS GPU会吞掉第一格的贴图，原因未知】
-    //     air_mesh._vertices.resize(6);
-    //     upload_mesh(air_mesh);
-    //     __meshes[0] = air_mesh;
-    // #endif
-    float d = 1 / (float)TEXTURE_SIZE; // 材质包中一个贴图占据的份额
-    for (int vy = 0; vy < TEXTURE_SIZE; ++vy)
+    auto loadStart = std::chrono::high_resolution_clock::now();
+    // 所有没有自己索引的四边形网格（逐面渲染的单位面、不透明区块网格）共用的索引，每个区块网格只需要存4个顶点/四边形；
+    // 放在静态几何的开头，绑定时偏移为0
+    std::vector<char> geometry(MESH_QUAD_MAX * 6 * sizeof(uint32_t));
+    uint32_t *quad_indices = (uint32_t *)geometry.data();
+    for (int i = 0; i < MESH_QUAD_MAX * 6; ++i)
+        quad_indices[i] = i / 6 * 4 + QUAD_INDEX_PATTERN[i % 6];
+
+    // 所有贴图共用一个单位面网格（逐面渲染的每个面都绑定它），贴图编号和面索引通过GPUObjectData传入，
+    // texture.vert据此把面内坐标换算成材质包中的贴图坐标，连续的面之间不需要切换顶点缓冲区
+    Mesh &mesh = __face_mesh;
+    mesh._vertices.resize(4);
+    // vertex positions，逆时针遍历顶点被认为是网格的正面，按QUAD_INDEX_PATTERN拆成两个三角形
+    //  以下坐标均基于自身坐标系，且单位是屏幕空间比例
+    mesh._vertices[0].position = {0.f, 0.f, 0.0f}; // 左下
+    mesh._vertices[1].position = {1.f, 0.f, 0.0f}; // 右下
+    mesh._vertices[2].position = {1.f, 1.f, 0.0f}; // 右上
+    mesh._vertices[3].position = {0.f, 1.f, 0.0f}; // 左上
+
+    for (int i = 0; i < 4; ++i)
     {
-        for (int ux = 0; ux < TEXTURE_SIZE; ++ux)
-        {
-            Mesh mesh;
-            mesh._vertices.resize(6);
-            // vertex positions，逆时针遍历顶点被认为是网格的正面
-            //  以下坐标均基于自身坐标系，且单位是屏幕空间比例
-            mesh._vertices[1].position = {0.f, .0f, 0.0f}; // 左下
-            mesh._vertices[0].position = {0.f, 1.f, 0.0f}; // 左上
-            mesh._vertices[2].position = {1.f, 1.f, 0.0f}; // 右上
-            mesh._vertices[3].position = {1.f, 1.f, 0.0f}; // 右上
-            mesh._vertices[5].position = {1.f, 0.f, 0.0f}; // 右下
-            mesh._vertices[4].position = {0.f, 0.f, 0.0f}; // 左下
-
-            // vertex colors，两个彩色直角三角形拼出来的正方形
-            //        mesh._vertices[0].color = { 1.f, 0.f, 0.0f };
-            //        mesh._vertices[1].color = { 1.f, 1.f, 1.0f };
-            //        mesh._vertices[2].color = { 0.f, 0.f, 1.0f };
-            //        mesh._vertices[3].color = { 0.f, 0.f, 1.0f };
-            //        mesh._vertices[4].color = { 0.f, 0.f, .0f };
-            //        mesh._vertices[5].color = { 0.f, 1.f, .0f };
-
-            for (int i = 0; i < 6; ++i)
-            {
-                mesh._vertices[i].uv = {
-                    (1 - mesh._vertices[i].position.x + ux) * d, // x方向颠倒
-                    (1 - mesh._vertices[i].position.y + vy) * d  // y方向要颠倒
-                };
-            }
-            // we don't care about the vertex normals
-            upload_mesh(mesh);
-            __meshes[vy * TEXTURE_SIZE + ux + isMac] = mesh;
-        }
+        // 面内坐标，着色器中加上贴图所在行列后换算到材质包
+        mesh._vertices[i].uv = {mesh._vertices[i].position.x, mesh._vertices[i].position.y};
     }
+    // 法线由texture.vert按面索引给出，这里不需要
+    append_static_mesh(geometry, mesh);
+
+    // 全部静态几何只分配一个缓冲、做一次复制
+    _static_geometry = upload_buffer(geometry.data(), geometry.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    cout << "Static geometry: " << geometry.size() << " bytes in one buffer, "
+         << std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - loadStart).count() / 1000.0 << " ms" << endl;
+
+    // 区块顶点池，不透明区块网格上传时从中分配
+    _chunk_vertex_pool = create_buffer(CHUNK_VERTEX_POOL_SIZE * sizeof(ChunkVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    _chunk_vertex_ranges.init(CHUNK_VERTEX_POOL_SIZE);
+    _main_deletion_queue.push_function([=]()
+                                       { vmaDestroyBuffer(_allocator, _chunk_vertex_pool._buffer, _chunk_vertex_pool._allocation); });
 }
 
 bool VenomApp::load_from_image(const char *file, AllocatedImage &outImage)
@@ -170,121 +204,147 @@ bool VenomApp::load_from_image(const char *file, AllocatedImage &outImage)
         return false;
     }
 
-    // 和upload_mesh类似，先放到CPU侧缓冲，再复制到VkImage（类似upload_mesh）
-    void *pixel_ptr = pixels;
+    // 和upload_buffer类似，先放到暂存环，再复制到VkImage
     VkDeviceSize imageSize = texWidth * texHeight * 4;
     // the format R8G8B8A8 matches exactly with the pixels loaded from stb_image lib
     VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
-    // allocate temporary buffer for holding texture data to upload
-    AllocatedBuffer stagingBuffer = create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-    // copy data to buffer
-    void *data;
-    vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-    memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-    // we no longer need the loaded data, so we can free the pixels as they are now in the staging buffer
-    stbi_image_free(pixels);
 
-    // 创建图像缓冲（类比upload_mesh的GPU侧缓冲），区别在于dimg_info的VK_IMAGE_USAGE_SAMPLED_BIT
+    // 创建图像缓冲（类比upload_buffer的GPU侧缓冲），区别在于dimg_info的VK_IMAGE_USAGE_SAMPLED_BIT
     VkExtent3D imageExtent{
         .width = static_cast<uint32_t>(texWidth),
         .height = static_cast<uint32_t>(texHeight),
         .depth = 1};
 
     VkImageCreateInfo dimg_info = vkinit::image_create_info(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+    uint32_t queueFamilies[] = {_graphics_queue_family, _upload_queue_family};
+    if (_upload_queue_family != _graphics_queue_family)
+    {
+        dimg_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        dimg_info.queueFamilyIndexCount = 2;
+        dimg_info.pQueueFamilyIndices = queueFamilies;
+    }
     AllocatedImage newImage;
     VmaAllocationCreateInfo dimg_allocinfo = {};
     dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     // allocate and create the image
     vmaCreateImage(_allocator, &dimg_info, &dimg_allocinfo, &newImage.image, &newImage.allocation, nullptr);
 
-    // 不能直接拷贝到Image，关于Barrier（一种同步原语）参见：https://gpuopen.com/learn/vulkan-barriers-explained/
-    immediate_submit([&](VkCommandBuffer cmd)
-                     {
-        VkImageSubresourceRange range {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .baseMipLevel = 0,
-            .levelCount = 1,
-            .baseArrayLayer = 0,
-            .layerCount = 1
-        };
-        // Layout切换为传输Barrier（用于复制）
-        VkImageMemoryBarrier imageBarrier_toTransfer = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-            .srcAccessMask = 0,
-            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            .image = newImage.image,
-            .subresourceRange = range,
-        };
-        //barrier the image into the transfer-receive layout
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
-        
-        // 从CPUBuffer复制到GPUImage
-        VkBufferImageCopy copyRegion = {
-            .bufferOffset = 0,
-            .bufferRowLength = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource = {
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = 0,
-                .baseArrayLayer = 0, // 和mipmap level有关
-                .layerCount = 1
-            },
-            .imageExtent = imageExtent
-        };
-        vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-        
-        // Layout切换为只读Barrier
-        VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-        imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        //barrier the image into the shader readable layout
-        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable); });
+    // 复制和布局转换记入本帧的上传批次，像素已经写入暂存环，可以立即释放
+    _uploader.copy_to_image(pixels, imageSize, newImage.image, imageExtent);
+    stbi_image_free(pixels);
 
     _main_deletion_queue.push_function([=]()
-                                       {
-        vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-        vmaDestroyImage(_allocator, newImage.image, newImage.allocation); });
+                                       { vmaDestroyImage(_allocator, newImage.image, newImage.allocation); });
 
     std::cout << "Texture loaded successfully " << file << std::endl;
     outImage = newImage;
     return true;
 }
 
-// 分配CPU_TO_GPU缓冲区，将Mesh放到该缓冲【弃用】
-// 分配CPU侧和GPU侧缓冲，将Mesh放到CPU侧缓冲，最后拷贝过去【更快】
-void VenomApp::upload_mesh(Mesh &mesh)
+// 通过暂存环把常驻数据上传到GPU侧缓冲，复制在本帧的上传批次中执行，退出时由_main_deletion_queue释放
+AllocatedBuffer VenomApp::upload_buffer(const void *src, size_t bufferSize, VkBufferUsageFlags usage)
 {
-    const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
     // 直接上传顶点缓冲区（低效）参数：VK_BUFFER_USAGE_VERTEX_BUFFER_BIT +  VMA_MEMORY_USAGE_CPU_TO_GPU，然后Map memory时直接拷贝到vertex buffer上
-    AllocatedBuffer stagingBuffer = create_buffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-    // 将顶点数据拷贝到上面的缓冲区（建立映射->拷贝->解除映射，对于流式数据则可以长期保持映射不解除）
-    void *data;
-    vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-    memcpy(data, mesh._vertices.data(), mesh._vertices.size() * sizeof(Vertex));
-    vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-
     // 接收的GPU侧缓冲
-    mesh._vertexBuffer = create_buffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+    AllocatedBuffer buffer = create_buffer(bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
     _main_deletion_queue.push_function([=]()
-                                       { vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer, mesh._vertexBuffer._allocation); });
+                                       { vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation); });
 
-    immediate_submit([=](VkCommandBuffer cmd)
-                     {
-        VkBufferCopy copy;
-        copy.dstOffset = 0;
-        copy.srcOffset = 0;
-        copy.size = bufferSize;
-        vkCmdCopyBuffer(cmd, stagingBuffer._buffer, mesh._vertexBuffer._buffer, 1, &copy); });
+    _uploader.copy_to_buffer(src, bufferSize, buffer._buffer, 0);
+    return buffer;
+}
 
-    vmaDestroyBuffer(_allocator, stagingBuffer._buffer, stagingBuffer._allocation);
+// 把新生成的区块网格上传到显存：所有顶点和索引写入暂存环，复制命令记入本帧的上传批次，由上传队列异步执行；
+// 不透明网格的顶点放进区块顶点池（池满时退回独立缓冲），半透明网格有自己的索引，单独绘制，使用独立缓冲；
+// 重新排序过的半透明网格只上传新索引，旧索引缓冲可能还在被之前的帧使用，延迟释放
+void VenomApp::upload_chunk_meshes()
+{
+    auto copy_to = [&](const void *src, size_t size, VkBuffer dst, VkDeviceSize dstOffset)
+    {
+        _uploader.copy_to_buffer(src, size, dst, dstOffset);
+        _frame_stats.upload_bytes += size;
+    };
+    auto stage = [&](const void *src, size_t size, AllocatedBuffer &dst, VkBufferUsageFlags usage)
+    {
+        dst = create_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        copy_to(src, size, dst._buffer, 0);
+    };
+    for (Mesh *mesh : __pending_meshes)
+    {
+        size_t vertexSize = mesh->_packed_vertices.size() * sizeof(ChunkVertex);
+        if (mesh->_indices.empty()) // 池满时返回的RangeAllocator::INVALID与MESH_NOT_POOLED相同
+            mesh->_pool_offset = _chunk_vertex_ranges.allocate(mesh->_packed_vertices.size());
+        if (mesh->_pool_offset != MESH_NOT_POOLED)
+            copy_to(mesh->_packed_vertices.data(), vertexSize, _chunk_vertex_pool._buffer, mesh->_pool_offset * sizeof(ChunkVertex));
+        else
+            stage(mesh->_packed_vertices.data(), vertexSize, mesh->_vertexBuffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        if (!mesh->_indices.empty())
+            stage(mesh->_indices.data(), mesh->_indices.size() * sizeof(uint32_t), mesh->_indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    }
+    for (Mesh *mesh : __resorted_meshes)
+    {
+        _retired_buffers.push_back({_current_frame, mesh->_indexBuffer});
+        stage(mesh->_indices.data(), mesh->_indices.size() * sizeof(uint32_t), mesh->_indexBuffer, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    }
+    __pending_meshes.clear();
+    __resorted_meshes.clear();
+}
+
+// 释放区块网格在显存中的顶点（或顶点池中的区间）和索引缓冲
+void VenomApp::destroy_chunk_mesh_buffers(Mesh *mesh)
+{
+    if (mesh->_pool_offset != MESH_NOT_POOLED)
+        _chunk_vertex_ranges.free(mesh->_pool_offset, mesh->_packed_vertices.size());
+    else
+        vmaDestroyBuffer(_allocator, mesh->_vertexBuffer._buffer, mesh->_vertexBuffer._allocation);
+    if (!mesh->_indices.empty())
+        vmaDestroyBuffer(_allocator, mesh->_indexBuffer._buffer, mesh->_indexBuffer._allocation);
+}
+
+// 网格绘制时绑定的顶点缓冲和索引缓冲（顶点池/静态几何中的网格绑定整个缓冲，没有自己索引的网格绑定静态几何开头的共享四边形索引）
+VkBuffer VenomApp::mesh_vertex_buffer(const Mesh *mesh) const
+{
+    if (mesh->_pool_offset != MESH_NOT_POOLED)
+        return _chunk_vertex_pool._buffer;
+    return mesh->_static_offset != MESH_NOT_STATIC ? _static_geometry._buffer : mesh->_vertexBuffer._buffer;
+}
+
+VkBuffer VenomApp::mesh_index_buffer(const Mesh *mesh) const
+{
+    return mesh->_indices.empty() ? _static_geometry._buffer : mesh->_indexBuffer._buffer;
+}
+
+// 释放被替换或取消渲染的区块网格，已提交的帧可能还在使用它们，因此要等MAX_FRAMES_IN_FLIGHT帧之后；all为true时（退出）释放全部区块网格
+void VenomApp::release_chunk_meshes(bool all)
+{
+    for (Mesh *mesh : __retired_meshes)
+        _retired_chunk_meshes.push_back({_current_frame, mesh});
+    __retired_meshes.clear();
+    while (!_retired_chunk_meshes.empty() && (all || _current_frame >= _retired_chunk_meshes.front().first + MAX_FRAMES_IN_FLIGHT))
+    {
+        Mesh *mesh = _retired_chunk_meshes.front().second;
+        destroy_chunk_mesh_buffers(mesh);
+        delete mesh;
+        _retired_chunk_meshes.pop_front();
+    }
+    while (!_retired_buffers.empty() && (all || _current_frame >= _retired_buffers.front().first + MAX_FRAMES_IN_FLIGHT))
+    {
+        AllocatedBuffer buffer = _retired_buffers.front().second;
+        vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+        _retired_buffers.pop_front();
+    }
+    if (all)
+    {
+        for (Chunk *chunk : __rendered_chunks)
+        {
+            for (Mesh *mesh : {chunk->mesh, chunk->translucent_mesh})
+            {
+                if (mesh && std::find(__pending_meshes.begin(), __pending_meshes.end(), mesh) == __pending_meshes.end())
+                    destroy_chunk_mesh_buffers(mesh);
+            }
+        }
+    }
 }
 
 void VenomApp::initWindow()
@@ -335,7 +395,7 @@ bool VenomApp::load_shader_module(const std::string &filePath, VkShaderModule *o
 }
 
 // 加载着色器等渲染管线所需（可以有多条渲染管线）【创建材质】直接从着色器文件读取纹理坐标构成网格
-void VenomApp::init_pipelines(const std::string &shader_vert_path, const std::string &shader_frag_path)
+void VenomApp::init_pipelines(const std::string &shader_vert_path, const std::string &shader_frag_path, const std::string &material_name, const VertexInputDescription &vertexDescription, bool translucent)
 {
     // 加载着色器文件
     VkShaderModule vertShader;
@@ -364,16 +424,13 @@ void VenomApp::init_pipelines(const std::string &shader_vert_path, const std::st
 
     // vertex input controls how to read vertices from vertex buffers.
     pipelineBuilder._vertexInputInfo = vkinit::vertex_input_state_create_info();
-    VertexInputDescription vertexDescription; // 【两条管线共用一个顶点输入描述】不能放在大括号里面，不然指针值会被丢弃！
-                                              //        if(useVertexBuffer) {
-    vertexDescription = Vertex::get_vertex_description();
+    // 顶点输入描述由调用者持有，管线创建完之前不能销毁，不然指针值会被丢弃！
     // connect the pipeline builder vertex input info to the one we get from Vertex
     pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions = vertexDescription.attributes.data();
     pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount = vertexDescription.attributes.size();
 
     pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions = vertexDescription.bindings.data();
     pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount = vertexDescription.bindings.size();
-    //        }
 
     // input assembly is the configuration for drawing triangle lists, strips, or individual points.
     // we are just going to draw triangle list
@@ -394,7 +451,7 @@ void VenomApp::init_pipelines(const std::string &shader_vert_path, const std::st
     pipelineBuilder._multisampling = vkinit::multisampling_state_create_info();
     // a single blend attachment with no blending and writing to RGBA
     pipelineBuilder._colorBlendAttachment = vkinit::color_blend_attachment_enable_state(VK_BLEND_FACTOR_ONE, VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, VK_BLEND_OP_ADD);
-    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, true, VK_COMPARE_OP);
+    pipelineBuilder._depthStencil = vkinit::depth_stencil_create_info(true, !translucent, VK_COMPARE_OP); // 半透明物体只做深度测试，不写深度
 
     // 构建texture管线，主要是使用的片元着色器不同
     pipelineBuilder._shaderStages.clear();
@@ -403,8 +460,10 @@ void VenomApp::init_pipelines(const std::string &shader_vert_path, const std::st
     pipelineBuilder._shaderStages.push_back(
         vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_FRAGMENT_BIT, fragShader)); // 区别
     pipelineBuilder._pipelineLayout = texPipelineLayout;
-    texPipeline = pipelineBuilder.build(_device, _render_pass);
-    __render_system.create_material(texPipeline, texPipelineLayout, _default_material_name);
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    texPipeline = pipelineBuilder.build(_device, _render_pass, _pipeline_cache);
+    _pipeline_build_time += std::chrono::high_resolution_clock::now() - buildStart;
+    __render_system.create_material(texPipeline, texPipelineLayout, material_name)->translucent = translucent;
 
     vkDestroyShaderModule(_device, vertShader, nullptr);
     vkDestroyShaderModule(_device, fragShader, nullptr);
@@ -424,6 +483,18 @@ void VenomApp::init_device_allocator_queue(class vkb::Instance &vkb_inst)
                                                  .set_surface(_surface)
                                                  .select()
                                                  .value();
+    // 间接绘制：一次调用提交多条命令，且命令的firstInstance用来索引物体数据
+    VkPhysicalDeviceFeatures indirect_features = {};
+    indirect_features.multiDrawIndirect = VK_TRUE;
+    indirect_features.drawIndirectFirstInstance = VK_TRUE;
+    _indirect_draw = INDIRECT_DRAW && physicalDeviceInfo.enable_features_if_present(indirect_features);
+    cout << "Indirect draw " << (_indirect_draw ? "enabled" : "disabled") << endl;
+    // 时间线信号量（Vulkan 1.1下为扩展）：上传批次提交后不等待，图形队列按批次的值等待
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+        .timelineSemaphore = VK_TRUE};
+    bool timeline = physicalDeviceInfo.enable_extension_if_present(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) &&
+                    physicalDeviceInfo.enable_extension_features_if_present(timeline_features);
 
     vkb::DeviceBuilder deviceBuilder{physicalDeviceInfo};
     // 启用向shader写入数据功能
@@ -451,6 +522,110 @@ void VenomApp::init_device_allocator_queue(class vkb::Instance &vkb_inst)
     // 初始化队列和队列簇
     _graphics_queue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     _graphics_queue_family = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+    // 专用传输队列（只支持传输的队列簇，通常对应独立的DMA引擎）上的复制与图形队列的渲染并行执行
+    auto transfer_queue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+    if (transfer_queue.has_value())
+    {
+        _upload_queue = transfer_queue.value();
+        _upload_queue_family = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+    }
+    else
+    {
+        _upload_queue = _graphics_queue;
+        _upload_queue_family = _graphics_queue_family;
+    }
+    cout << "Upload queue: " << (transfer_queue.has_value() ? "dedicated transfer" : "graphics") << ", timeline semaphore " << (timeline ? "enabled" : "disabled") << endl;
+    _uploader.init(_device, _allocator, _upload_queue, _upload_queue_family, UPLOAD_RING_SIZE, timeline);
+    _main_deletion_queue.push_function([&]()
+                                       { _uploader.destroy(); });
+}
+
+// 管线缓存文件头：驱动只认自己生成的缓存数据，有的驱动收到其他设备或旧版本驱动的数据会出错，因此加载前自行校验
+struct PipelineCacheHeader
+{
+    uint32_t magic;
+    uint32_t dataSize; // 文件头之后的缓存数据字节数
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x564E5043; // "VNPC"
+
+// 当前设备对应的文件头
+static PipelineCacheHeader pipeline_cache_header(VkPhysicalDevice physicalDevice, uint32_t dataSize)
+{
+    VkPhysicalDeviceIDProperties idProperties = {.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &idProperties};
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+    PipelineCacheHeader header = {
+        .magic = PIPELINE_CACHE_MAGIC,
+        .dataSize = dataSize,
+        .vendorID = properties.properties.vendorID,
+        .deviceID = properties.properties.deviceID,
+        .driverVersion = properties.properties.driverVersion};
+    memcpy(header.deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+    memcpy(header.pipelineCacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+// 从PIPELINE_CACHE_FILE加载管线缓存，文件不存在或不是当前设备和驱动生成的则从空缓存开始；退出时写回
+void VenomApp::init_pipeline_cache()
+{
+    std::vector<char> data;
+    std::ifstream file(PIPELINE_CACHE_FILE, std::ios::ate | std::ios::binary);
+    if (file.is_open())
+    {
+        size_t fileSize = (size_t)file.tellg();
+        PipelineCacheHeader header = {}, expected = pipeline_cache_header(_physical_device, 0);
+        file.seekg(0);
+        if (fileSize >= sizeof(header) && file.read((char *)&header, sizeof(header)))
+        {
+            expected.dataSize = header.dataSize;
+            if (memcmp(&header, &expected, sizeof(header)) == 0 && header.dataSize == fileSize - sizeof(header))
+            {
+                data.resize(header.dataSize);
+                file.read(data.data(), data.size());
+            }
+        }
+        if (data.empty())
+            cout << "Pipeline cache discarded: created by another device or driver" << endl;
+    }
+    _pipeline_cache_loaded = !data.empty();
+    if (_pipeline_cache_loaded)
+        cout << "Pipeline cache loaded: " << data.size() << " bytes" << endl;
+
+    VkPipelineCacheCreateInfo cacheInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data()};
+    VK_CHECK(vkCreatePipelineCache(_device, &cacheInfo, nullptr, &_pipeline_cache));
+    _main_deletion_queue.push_function([=]()
+                                       {
+            save_pipeline_cache();
+            vkDestroyPipelineCache(_device, _pipeline_cache, nullptr); });
+}
+
+// 把管线缓存（加上本次启动新编译的管线）写回PIPELINE_CACHE_FILE
+void VenomApp::save_pipeline_cache()
+{
+    size_t dataSize = 0;
+    VK_CHECK(vkGetPipelineCacheData(_device, _pipeline_cache, &dataSize, nullptr));
+    std::vector<char> data(dataSize);
+    VK_CHECK(vkGetPipelineCacheData(_device, _pipeline_cache, &dataSize, data.data()));
+    PipelineCacheHeader header = pipeline_cache_header(_physical_device, (uint32_t)dataSize);
+    std::ofstream file(PIPELINE_CACHE_FILE, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        cout << "Failed to write pipeline cache " << PIPELINE_CACHE_FILE << endl;
+        return;
+    }
+    file.write((const char *)&header, sizeof(header));
+    file.write(data.data(), dataSize);
+    cout << "Pipeline cache saved: " << dataSize << " bytes" << endl;
 }
 
 // 初始化Swapchain，需要获取窗口尺寸来转换成_window_extent
@@ -477,8 +652,8 @@ void VenomApp::init_swapchain()
 void VenomApp::init_depth_image()
 {
     _depth_image.imageFormat = VK_FORMAT_D32_SFLOAT;
-    // VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT告知该Image用于深度
-    VkImageCreateInfo dimg_info = vkinit::image_create_info(_depth_image.imageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, _depth_extent);
+    // VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT告知该Image用于深度，RenderPass结束后还要作为生成深度金字塔的源被采样
+    VkImageCreateInfo dimg_info = vkinit::image_create_info(_depth_image.imageFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, _depth_extent);
     VmaAllocationCreateInfo dimg_allocinfo = {
         .usage = VMA_MEMORY_USAGE_GPU_ONLY, // 分配在显存上
         .requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
@@ -493,7 +668,7 @@ void VenomApp::init_depth_image()
             vmaDestroyImage(_allocator, _depth_image.image, _depth_image.allocation); });
 }
 
-// 创建_command_pool和专用于CPU拷贝到GPU指令的_upload_command_pool，他们共享同一个CommandQueue
+// 创建_command_pool和初始化时做布局转换的_upload_context命令池，他们共享同一个CommandQueue（网格和纹理的上传由_uploader管理自己的命令池）
 void VenomApp::init_command_pool_and_queue()
 {
     // create a command pool for commands submitted to the graphics queue.
@@ -520,7 +695,21 @@ void VenomApp::init_command_pool_and_queue()
         VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_frames[i]._mainCommandBuffer));
         _main_deletion_queue.push_function([=]()
                                            { vkDestroyCommandPool(_device, _frames[i]._commandPool, nullptr); });
+
+        // 录制线程的命令池每帧整池重置，不需要单独重置命令缓冲
+        VkCommandPoolCreateInfo recordPoolInfo = vkinit::command_pool_create_info(_graphics_queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        _frames[i]._recordPools.resize(RECORD_WORKER_COUNT);
+        _frames[i]._recordCommandBuffers.resize(RECORD_WORKER_COUNT);
+        for (int w = 0; w < RECORD_WORKER_COUNT; w++)
+        {
+            VK_CHECK(vkCreateCommandPool(_device, &recordPoolInfo, nullptr, &_frames[i]._recordPools[w]));
+            VkCommandBufferAllocateInfo secondaryAllocInfo = vkinit::command_buffer_allocate_info(_frames[i]._recordPools[w], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+            VK_CHECK(vkAllocateCommandBuffers(_device, &secondaryAllocInfo, &_frames[i]._recordCommandBuffers[w]));
+            _main_deletion_queue.push_function([=]()
+                                               { vkDestroyCommandPool(_device, _frames[i]._recordPools[w], nullptr); });
+        }
     }
+    _record_workers.start(RECORD_WORKER_COUNT);
 }
 
 // 附件引用索引=>子管道，配置附件+子管道间依赖关系+子管道=>RenderPass
@@ -547,11 +736,11 @@ void VenomApp::init_render_pass()
         .format = _depth_image.imageFormat, // 与color_attachment不同
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE, // 保留深度，RenderPass之后生成深度金字塔
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE, // 与color_attachment不同
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL // 与color_attachment不同
+        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL // 与color_attachment不同，结束后供计算着色器采样
     };
     VkAttachmentReference depth_attachment_ref = {
         .attachment = 1,
@@ -583,14 +772,23 @@ void VenomApp::init_render_pass()
         .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         .srcAccessMask = 0,
         .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT};
+    // 上一帧生成深度金字塔时（计算着色器）读完深度图，才能清空
     VkSubpassDependency depth_dependency = {
         .srcSubpass = VK_SUBPASS_EXTERNAL,
         .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
         .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
         .srcAccessMask = 0,
         .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
-    VkSubpassDependency dependencies[2] = {color_dependency, depth_dependency};
+    // 深度写完，RenderPass之后的计算着色器才能读取它生成深度金字塔
+    VkSubpassDependency pyramid_dependency = {
+        .srcSubpass = 0,
+        .dstSubpass = VK_SUBPASS_EXTERNAL,
+        .srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT};
+    VkSubpassDependency dependencies[3] = {color_dependency, depth_dependency, pyramid_dependency};
 
     // 使用color_attachment和depth_attachment创建_render_pass
     VkAttachmentDescription attachments[2] = {color_attachment, depth_attachment};
@@ -655,7 +853,7 @@ void VenomApp::init_syncs()
                 vkDestroySemaphore(_device, _frames[i]._presentSemaphore, nullptr);
                 vkDestroySemaphore(_device, _frames[i]._renderSemaphore, nullptr); });
     }
-    // 注意没有提供VK_FENCE_CREATE_SIGNALED_BIT标识，因为它是立即执行的，而非renderloop中等待其他同步原语
+    // 注意没有提供VK_FENCE_CREATE_SIGNALED_BIT标识，immediate_submit提交后才等待它
     VkFenceCreateInfo uploadFenceCreateInfo = vkinit::fence_create_info();
 
     VK_CHECK(vkCreateFence(_device, &uploadFenceCreateInfo, nullptr, &_upload_context._uploadFence));
@@ -674,11 +872,16 @@ void VenomApp::init_descriptor_pool()
             {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, UNIFORM_BUFFERS_CNT},
             // ShadowMap采样器
             {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, UNIFORM_BUFFERS_CNT},
+            // GPU剔除：每帧一个参数缓冲、五个存储缓冲和深度金字塔；生成深度金字塔时每层一个源和一个目标
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, MAX_FRAMES_IN_FLIGHT},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT * 5},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_FRAMES_IN_FLIGHT + DEPTH_PYRAMID_MAX_LEVELS},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DEPTH_PYRAMID_MAX_LEVELS},
         };
     VkDescriptorPoolCreateInfo pool_info = {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .flags = 0,
-        .maxSets = UNIFORM_BUFFERS_CNT,
+        .maxSets = UNIFORM_BUFFERS_CNT + MAX_FRAMES_IN_FLIGHT + DEPTH_PYRAMID_MAX_LEVELS,
         .poolSizeCount = (uint32_t)sizes.size(),
         .pPoolSizes = sizes.data()};
     vkCreateDescriptorPool(_device, &pool_info, nullptr, &_descriptor_pool);
@@ -699,7 +902,10 @@ void VenomApp::init_descriptor_set_layouts()
 
     // 使用StorageBuffer存储场景所有对象矩阵
     VkDescriptorSetLayoutBinding objectBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-    VkDescriptorSetLayoutCreateInfo set1info = vkinit::descriptorset_layout_create_info(1, &objectBind);
+    // binding 1：实例到对象的映射
+    VkDescriptorSetLayoutBinding instanceBind = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1);
+    VkDescriptorSetLayoutBinding bindings1[] = {objectBind, instanceBind};
+    VkDescriptorSetLayoutCreateInfo set1info = vkinit::descriptorset_layout_create_info(sizeof(bindings1) / sizeof(VkDescriptorSetLayoutBinding), bindings1);
     vkCreateDescriptorSetLayout(_device, &set1info, nullptr, &_object_set_layout);
 
     // set 2
@@ -725,14 +931,14 @@ void VenomApp::init_descriptor_sets()
 {
     // 多重缓冲共享scene_buffer，因此该buffer不属于FrameData
     const size_t sceneParamBufferSize = MAX_FRAMES_IN_FLIGHT * pad_uniform_buffer_size(sizeof(GPUSceneData));
-    _scene_parameter_buffer = create_buffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    _scene_parameter_buffer = create_buffer(sceneParamBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
     
-    _light_space_buffer = create_buffer(sizeof(GPULightSpaceData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    _light_space_buffer = create_buffer(sizeof(GPULightSpaceData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
 
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         // 相机矩阵缓冲 - Uniform Buffer
-        _frames[i].cameraBuffer = create_buffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        _frames[i].cameraBuffer = create_buffer(sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
         // allocate one descriptor set for each frame
         VkDescriptorSetAllocateInfo globalSetAlloc = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -748,7 +954,7 @@ void VenomApp::init_descriptor_sets()
         VkWriteDescriptorSet cameraWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[i].globalDescriptorSet, &cameraInfo, 0);
 
         // 物体对象缓冲 - Storage Buffer
-        _frames[i].objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        _frames[i].objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
         // allocate the descriptor set that will point to object buffer
         VkDescriptorSetAllocateInfo objectSetAlloc = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
@@ -763,6 +969,17 @@ void VenomApp::init_descriptor_sets()
             .range = sizeof(GPUObjectData) * MAX_OBJECTS};
         VkWriteDescriptorSet objectWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].objectDescriptorSet, &objectInfo, 0);
 
+        // 实例到对象的映射 - Storage Buffer
+        _frames[i].instanceBuffer = create_buffer(sizeof(uint32_t) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+        VkDescriptorBufferInfo instanceInfo{
+            .buffer = _frames[i].instanceBuffer._buffer,
+            .offset = 0,
+            .range = sizeof(uint32_t) * MAX_OBJECTS};
+        VkWriteDescriptorSet instanceWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].objectDescriptorSet, &instanceInfo, 1);
+
+        // 间接绘制命令缓冲，CPU每帧写入，GPU剔除时由计算着色器累加instanceCount
+        _frames[i].indirectBuffer = create_buffer(sizeof(VkDrawIndexedIndirectCommand) * MAX_OBJECTS, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+
         //  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER需要手动计算offset：sceneInfo.offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * i;
         // VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC可以不配置offset，在drawcall期间直接变换
         VkDescriptorBufferInfo sceneInfo{
@@ -778,7 +995,7 @@ void VenomApp::init_descriptor_sets()
         };
         VkWriteDescriptorSet lightSpaceWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[i].globalDescriptorSet, &lightSpaceInfo, 2);
 
-        VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite, objectWrite, lightSpaceWrite};
+        VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite, objectWrite, instanceWrite, lightSpaceWrite};
         vkUpdateDescriptorSets(_device, sizeof(setWrites) / sizeof(VkWriteDescriptorSet), setWrites, 0, nullptr);
     }
     _main_deletion_queue.push_function([&]()
@@ -789,6 +1006,8 @@ void VenomApp::init_descriptor_sets()
             {
                 vmaDestroyBuffer(_allocator, _frames[i].cameraBuffer._buffer, _frames[i].cameraBuffer._allocation);
                 vmaDestroyBuffer(_allocator, _frames[i].objectBuffer._buffer, _frames[i].objectBuffer._allocation);
+                vmaDestroyBuffer(_allocator, _frames[i].instanceBuffer._buffer, _frames[i].instanceBuffer._allocation);
+                vmaDestroyBuffer(_allocator, _frames[i].indirectBuffer._buffer, _frames[i].indirectBuffer._allocation);
             } });
 
     // 纹理采样器
@@ -838,11 +1057,16 @@ void VenomApp::init_descriptor_sets()
     
     VkWriteDescriptorSet writes[] = {textureWrite, shadowWrite};
     vkUpdateDescriptorSets(_device, sizeof(writes) / sizeof(VkWriteDescriptorSet), writes, 0, nullptr);
+
+    // 区块材质与默认材质采样同一张材质包和阴影贴图
+    __render_system.get_material(_chunk_material_name)->textureSet = texturedMat->textureSet;
+    __render_system.get_material(_chunk_translucent_material_name)->textureSet = texturedMat->textureSet;
 }
 
 // 初始化Vulkan对象
 void VenomApp::initVulkan()
 {
+    auto startupStart = std::chrono::high_resolution_clock::now();
     // 初始化Vk实例，可配置项：App名称（用于显卡驱动识别3A做针对性优化）、使用验证层调试、VulkanAPI版本
     vkb::InstanceBuilder builder;
 
@@ -863,21 +1087,26 @@ void VenomApp::initVulkan()
     }
 
     init_device_allocator_queue(vkb_inst);
+    init_pipeline_cache();
     init_swapchain();
     init_depth_image();
-    init_shadow_map();
     init_command_pool_and_queue();
     init_render_pass();
     init_framebuffers();
     init_syncs();
+    init_shadow_map(); // 布局转换用到immediate_submit，须在命令池和栅栏创建之后
     init_descriptor_pool();
     init_descriptor_set_layouts();
-    init_pipelines(string(SHADER_DIR) + "texture_vert.spv", string(SHADER_DIR) + "texture_frag.spv");
+    init_pipelines(string(SHADER_DIR) + "texture_vert.spv", string(SHADER_DIR) + "texture_frag.spv", _default_material_name, Vertex::get_vertex_description());
+    init_pipelines(string(SHADER_DIR) + "chunk_vert.spv", string(SHADER_DIR) + "chunk_frag.spv", _chunk_material_name, ChunkVertex::get_vertex_description()); // 区块合并网格使用压缩顶点
+    init_pipelines(string(SHADER_DIR) + "chunk_vert.spv", string(SHADER_DIR) + "chunk_frag.spv", _chunk_translucent_material_name, ChunkVertex::get_vertex_description(), true);
 
     // 13.创建或者从文件读取纹理、网格数据，分配缓冲区。
     load_texture();
     load_meshes();
     init_descriptor_sets(); // 阴影映射加入了一个采样器（set = 2, binding = 1）
+    init_gpu_culling();
+    __gpu_culling = GPU_CULLING;
 
     // ShadowMap功能
     init_shadow_render_pass();
@@ -887,36 +1116,73 @@ void VenomApp::initVulkan()
     // 14.通过meshes和materials布置场景
     __render_system.init_scene();
 
+    // 对比有无管线缓存时的启动耗时（删除PIPELINE_CACHE_FILE即可复现无缓存的情况）
+    auto to_ms = [](std::chrono::high_resolution_clock::duration d)
+    { return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.0; };
+    cout << "Startup: " << to_ms(std::chrono::high_resolution_clock::now() - startupStart) << " ms, pipelines: " << to_ms(_pipeline_build_time)
+         << " ms (" << (_pipeline_cache_loaded ? "with" : "without") << " pipeline cache)" << endl;
+
     _is_initialized = true;
 }
 
-// 更新渲染资源
+static_assert(CHUNK_MAX_XZ * CHUNK_LEN <= INT16_MAX && CHUNK_MAX_Y * CHUNK_LEN <= INT16_MAX, "world block coordinates are packed into 16 bits");
+static_assert(TEXTURE_SIZE * TEXTURE_SIZE <= 256, "tile indices are packed into 8 bits");
+
+// 把渲染对象压缩成GPUObjectData：坐标取低16位（着色器中符号扩展），光强各通道量化到8位
+static GPUObjectData pack_object_data(const RenderObject &object)
+{
+    glm::uvec4 light = glm::uvec4(glm::clamp(object.objectLight, 0.f, 1.f) * 255.f + 0.5f);
+    return {((uint32_t)object.pos.x & 0xFFFF) | ((uint32_t)object.pos.y & 0xFFFF) << 16,
+            ((uint32_t)object.pos.z & 0xFFFF) | (uint32_t)object.face << 16 | (uint32_t)object.tile << 24,
+            light.r | light.g << 8 | light.b << 16 | light.a << 24};
+}
+
+// 顶点池或静态几何中的网格从缓冲内偏移处取顶点
+static int32_t vertex_offset(const Mesh *mesh)
+{
+    if (mesh->_pool_offset != MESH_NOT_POOLED)
+        return (int32_t)mesh->_pool_offset;
+    return mesh->_static_offset != MESH_NOT_STATIC ? (int32_t)mesh->_static_offset : 0;
+}
+
+// 更新渲染资源：所有缓冲持久映射，只写入内容改变的部分，须在本帧的栅栏等待之后调用（GPU不再读取本帧的缓冲）
 void VenomApp::update_render_resource(FrameData &current_frame)
 {
-    // 场景参数
+    // 场景参数，每帧在_scene_parameter_buffer中有自己的槽位
     _scene_parameters.ambientColor = __main_level.sky_color;
-    char *sceneData;
-    vmaMapMemory(_allocator, _scene_parameter_buffer._allocation, (void **)&sceneData);
+    _scene_parameters.fogDistance.w = SHADOW_MAP_SAMPLING ? 1.f : 0.f;
     int frameIndex = _current_frame % MAX_FRAMES_IN_FLIGHT;
-    sceneData += pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex;
-    memcpy(sceneData, &_scene_parameters, sizeof(GPUSceneData));
-    vmaUnmapMemory(_allocator, _scene_parameter_buffer._allocation);
-
-    // 物体对象数据，不使用memcpy是因为类型复杂
-    void *objectData;
-    vmaMapMemory(_allocator, current_frame.objectBuffer._allocation, &objectData);
-    GPUObjectData *objectSSBO = (GPUObjectData *)objectData; // SSBO着色器阶段缓冲对象——可读写，大内存，相对较慢，可运用在所有着色器
-    for (int i = 0; i < __renderables.size(); i++)
+    write_mapped_if_changed(_scene_parameter_buffer, pad_uniform_buffer_size(sizeof(GPUSceneData)) * frameIndex, _scene_parameters, _uploaded_scene[frameIndex]);
+
+    // 物体对象数据：改变的槽位记到每一帧的脏列表里，本帧只重写自己列表中的槽位，连续的槽位合并成一个区间刷新
+    if (!__dirty_renderables.empty())
     {
-        if (__renderables[i].mesh == nullptr || __renderables[i].material == nullptr)
-            continue;
-        objectSSBO[i].modelMatrix = __renderables[i].model_transform; // 【不能为了跳过空的RenderObject而压缩objectSSBO的索引！否则会出现内存位置偏移导致的显示错误！】
-        objectSSBO[i].objectLight = __renderables[i].objectLight;
-        objectSSBO[i].normal = glm::vec4(__renderables[i].normal, 1.f);
+        for (FrameData &frame : _frames)
+            frame.dirtyObjects.insert(frame.dirtyObjects.end(), __dirty_renderables.begin(), __dirty_renderables.end());
+        __dirty_renderables.clear();
+    }
+    vector<uint32_t> &dirty = current_frame.dirtyObjects;
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    GPUObjectData *objectSSBO = (GPUObjectData *)current_frame.objectBuffer._mapped; // SSBO着色器阶段缓冲对象——可读写，大内存，相对较慢，可运用在所有着色器
+    for (size_t k = 0; k < dirty.size() && dirty[k] < __renderables.size();)
+    {
+        uint32_t first = dirty[k], last = first;
+        while (++k < dirty.size() && dirty[k] == last + 1 && dirty[k] < __renderables.size())
+            ++last;
+        for (uint32_t i = first; i <= last; i++)
+        {
+            if (__renderables[i].mesh == nullptr || __renderables[i].material == nullptr)
+                continue;
+            objectSSBO[i] = pack_object_data(__renderables[i]); // 【不能为了跳过空的RenderObject而压缩objectSSBO的索引！否则会出现内存位置偏移导致的显示错误！】
+        }
+        size_t bytes = sizeof(GPUObjectData) * (last - first + 1);
+        vmaFlushAllocation(_allocator, current_frame.objectBuffer._allocation, sizeof(GPUObjectData) * first, bytes);
+        _frame_stats.upload_bytes += bytes;
     }
-    vmaUnmapMemory(_allocator, current_frame.objectBuffer._allocation);
+    dirty.clear();
 
-    // ShadowMap: 更新光照空间数据
+    // ShadowMap: 更新光照空间数据（所有帧共用一个缓冲，内容不变时不再写入）
     GPULightSpaceData lightSpaceData;
     // 这里需要根据实际情况计算光照空间的视图和投影矩阵
     // 示例：假设光源位置和方向
@@ -924,15 +1190,11 @@ void VenomApp::update_render_resource(FrameData &current_frame)
     glm::vec3 lightDir = glm::normalize(-lightPos);
     lightSpaceData.lightView = glm::lookAt(lightPos, lightPos + lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
     lightSpaceData.lightProj = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 50.0f);
-
-    void *lightSpaceDataPtr;
-    vmaMapMemory(_allocator, _light_space_buffer._allocation, &lightSpaceDataPtr);
-    memcpy(lightSpaceDataPtr, &lightSpaceData, sizeof(GPULightSpaceData));
-    vmaUnmapMemory(_allocator, _light_space_buffer._allocation);
+    write_mapped_if_changed(_light_space_buffer, 0, lightSpaceData, _uploaded_light_space);
 }
 
-// 将更新数据拷贝/映射到缓冲区 -> (管线变化时)重新绑定材质对应的管线及描述符集合
-void VenomApp::draw_objects(VkCommandBuffer cmd, FrameData &current_frame)
+// 录制前准备本帧的绘制：写入相机，视锥剔除，按网格分桶，写入实例缓冲和间接绘制命令；GPU剔除时不透明物体只写入候选，由cull.comp填写实例
+void VenomApp::prepare_draws(FrameData &current_frame)
 {
     // 现在用StorageBuffer传输所有物体的矩阵到GPU，下面代码逐物体传输pushconstants严重影响帧率【过时】
     //            MeshPushConstants constants;
@@ -942,56 +1204,301 @@ void VenomApp::draw_objects(VkCommandBuffer cmd, FrameData &current_frame)
     // 上传光源主视角和光照矩阵到显存，将大量的矩阵相乘交给GPU， 用shader计算矩阵相乘结果
     GPUCameraData cameraData;
     __main_camera.set_camera_vp_matrices(cameraData);
-    void *data;
-    vmaMapMemory(_allocator, current_frame.cameraBuffer._allocation, &data);
-    memcpy(data, &cameraData, sizeof(GPUCameraData));
-    vmaUnmapMemory(_allocator, current_frame.cameraBuffer._allocation);
-
-    // 纹理数据
-    Mesh *lastMesh = nullptr;
-    Material *lastMaterial = nullptr;
+    write_mapped_if_changed(current_frame.cameraBuffer, 0, cameraData, _uploaded_camera[_current_frame % MAX_FRAMES_IN_FLIGHT]);
+    _view_proj = cameraData.proj * cameraData.view;
+    Frustum frustum = extract_frustum(_view_proj);
+    _gpu_culling_frame = __gpu_culling && _indirect_draw;
+
+    // 把物体按网格分桶：同一网格的物体在实例缓冲中占一段连续区间，用一次实例化绘制（instanceCount为桶大小）画完，
+    // 着色器通过实例缓冲找到物体在objectBuffer中的槽位；逐面渲染时所有面共用一个单位面网格，只有一个桶
+    struct DrawBucket
+    {
+        Material *material;
+        const Mesh *mesh;
+        uint32_t first; // 桶在实例缓冲中的起点
+        uint32_t count;
+    };
+    static vector<DrawBucket> buckets;
+    static vector<int> bucket_of;                          // 每个物体所在的桶
+    static unordered_map<const Mesh *, int> opaque_bucket; // 不透明物体按网格查桶
+    static vector<pair<float, int>> translucent;
+    buckets.clear();
+    bucket_of.assign(__renderables.size(), -1);
+    opaque_bucket.clear();
+    translucent.clear();
+
+    // 视锥剔除：存活物体的包围盒（区块网格为整个区块，逐面渲染为面所在的方块）成批测试，只有可见的物体进入分桶
+    static vector<int> live;
+    static AABBBatch boxes;
+    static vector<uint8_t> visible;
+    live.clear();
+    boxes.clear();
     for (int i = 0; i < __renderables.size(); i++)
     {
-        if (__renderables[i].mesh == nullptr || __renderables[i].material == nullptr)
+        const RenderObject &object = __renderables[i];
+        if (object.mesh == nullptr || object.material == nullptr)
             continue;
-        RenderObject &object = __renderables[i];
-        // 只有当要渲染的材质和上一个不同时，才要重新绑定管线；管线不同时，也要重新绑定DescriptorSet
-        if (object.material != lastMaterial)
+        live.push_back(i);
+        float extent = object.face == OBJECT_FACE_NONE ? CHUNK_LEN : 1.f;
+        boxes.push(glm::vec3(object.pos), glm::vec3(object.pos) + extent);
+    }
+    if (FRUSTUM_CULLING)
+        boxes.cull(frustum, visible);
+    else
+        visible.assign(live.size(), 1);
+
+    glm::vec3 camera_pos = __main_camera.entity.pos;
+    for (size_t k = 0; k < live.size(); k++)
+    {
+        int i = live[k];
+        const RenderObject &object = __renderables[i];
+        if (!visible[k])
         {
-            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
-            lastMaterial = object.material;
-            // bind the descriptor set when changing pipeline
-            // offset for our scene buffer
-            uint32_t dynamic_uniform_offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * (_current_frame % MAX_FRAMES_IN_FLIGHT);
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 0, 1, &current_frame.globalDescriptorSet, 1, &dynamic_uniform_offset);
-            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 1, 1, &current_frame.objectDescriptorSet, 0, nullptr);
-            if (object.material->textureSet != VK_NULL_HANDLE)
-            {
-                // texture descriptor
-                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout, 2, 1, &object.material->textureSet, 0, nullptr);
-            }
+            ++_frame_stats.culled;
+            continue;
+        }
+        ++_frame_stats.objects;
+        if (object.material->translucent)
+        { // 半透明物体之后按区块从远到近排序，每个单独成桶
+            glm::vec3 center = glm::vec3(object.pos) + CHUNK_LEN * 0.5f;
+            translucent.push_back({glm::distance(center, camera_pos), i});
+            continue;
+        }
+        auto found = opaque_bucket.find(object.mesh);
+        if (found == opaque_bucket.end() || buckets[found->second].material != object.material)
+        {
+            found = opaque_bucket.insert_or_assign(object.mesh, (int)buckets.size()).first;
+            buckets.push_back({object.material, object.mesh, 0, 0});
+        }
+        bucket_of[i] = found->second;
+        ++buckets[found->second].count;
+    }
+    // 共用材质和缓冲的桶相邻，间接绘制时可以合并成一次调用
+    static vector<int> order;
+    order.resize(buckets.size());
+    for (int b = 0; b < order.size(); ++b)
+        order[b] = b;
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+              {
+                  const DrawBucket &x = buckets[a], &y = buckets[b];
+                  return std::make_tuple(x.material, mesh_vertex_buffer(x.mesh), mesh_index_buffer(x.mesh), a) <
+                         std::make_tuple(y.material, mesh_vertex_buffer(y.mesh), mesh_index_buffer(y.mesh), b); });
+    static vector<uint32_t> command_of; // 不透明桶对应的间接绘制命令序号
+    command_of.resize(buckets.size());
+    uint32_t instance_count = 0;
+    for (int k = 0; k < order.size(); ++k)
+    {
+        buckets[order[k]].first = instance_count;
+        instance_count += buckets[order[k]].count;
+        command_of[order[k]] = k;
+    }
+    uint32_t opaque_instance_count = instance_count;
+    size_t opaque_bucket_count = buckets.size();
+    std::sort(translucent.begin(), translucent.end(), std::greater<pair<float, int>>());
+    for (auto &item : translucent)
+    {
+        bucket_of[item.second] = buckets.size();
+        buckets.push_back({__renderables[item.second].material, __renderables[item.second].mesh, instance_count++, 1});
+    }
+
+    // 写入实例缓冲：按桶的区间填入物体槽位；GPU剔除时不透明物体改为写入候选（槽位，命令序号），实例区间由cull.comp填写
+    uint32_t *instances = (uint32_t *)current_frame.instanceBuffer._mapped;
+    uint32_t *candidates = (uint32_t *)current_frame.cullCandidateBuffer._mapped;
+    uint32_t candidate_count = 0;
+    static vector<uint32_t> filled;
+    filled.assign(buckets.size(), 0);
+    for (int i = 0; i < bucket_of.size(); i++)
+    {
+        int b = bucket_of[i];
+        if (b < 0)
+            continue;
+        if (_gpu_culling_frame && b < opaque_bucket_count)
+        {
+            candidates[candidate_count * 2] = i;
+            candidates[candidate_count * 2 + 1] = command_of[b];
+            ++candidate_count;
+        }
+        else
+            instances[buckets[b].first + filled[b]++] = i;
+    }
+    uint32_t instance_first = _gpu_culling_frame ? opaque_instance_count : 0;
+    if (instance_count > instance_first)
+        vmaFlushAllocation(_allocator, current_frame.instanceBuffer._allocation, sizeof(uint32_t) * instance_first, sizeof(uint32_t) * (instance_count - instance_first));
+    _frame_stats.upload_bytes += sizeof(uint32_t) * (instance_count - instance_first);
+
+    if (_indirect_draw)
+    {
+        // 每个桶一条间接绘制命令；GPU剔除时instanceCount从0开始，由通过测试的物体累加
+        VkDrawIndexedIndirectCommand *commands = (VkDrawIndexedIndirectCommand *)current_frame.indirectBuffer._mapped;
+        for (int k = 0; k < order.size(); ++k)
+        {
+            const DrawBucket &bucket = buckets[order[k]];
+            commands[k] = {(uint32_t)bucket.mesh->index_count(), _gpu_culling_frame ? 0 : bucket.count, 0, vertex_offset(bucket.mesh), bucket.first};
         }
+        if (!order.empty())
+            vmaFlushAllocation(_allocator, current_frame.indirectBuffer._allocation, 0, sizeof(VkDrawIndexedIndirectCommand) * order.size());
+        _frame_stats.upload_bytes += sizeof(VkDrawIndexedIndirectCommand) * order.size();
+    }
 
-        // 只有和上次的VertexBuffer不同时，才需要重新绑定
-        if (object.mesh != lastMesh)
+    current_frame.cullCandidates = _gpu_culling_frame ? candidate_count : 0;
+    if (_gpu_culling_frame)
+    {
+        if (candidate_count > 0)
+            vmaFlushAllocation(_allocator, current_frame.cullCandidateBuffer._allocation, 0, sizeof(uint32_t) * 2 * candidate_count);
+        _frame_stats.upload_bytes += sizeof(uint32_t) * 2 * candidate_count;
+        GPUCullParams params;
+        std::copy(std::begin(frustum.planes), std::end(frustum.planes), params.planes);
+        params.prevViewProj = _depth_pyramid_view_proj;
+        params.pyramid = glm::ivec4(_depth_pyramid.imageExtent.width, _depth_pyramid.imageExtent.height, _depth_pyramid_levels, _depth_pyramid_ready ? 1 : 0);
+        params.counts = glm::uvec4(candidate_count, 0, 0, 0);
+        write_mapped(current_frame.cullParamBuffer, 0, &params, sizeof(GPUCullParams));
+    }
+
+    // 先画不透明物体，半透明物体（不写深度）留到最后按区块从远到近绘制，区块内的四边形已经排好序
+    _draw_items.clear();
+    if (_indirect_draw)
+    {
+        // 共用材质和缓冲的连续几条间接绘制命令用一次vkCmdDrawIndexedIndirect提交
+        uint32_t maxDrawCount = _gpu_properties.limits.maxDrawIndirectCount;
+        for (uint32_t k = 0; k < order.size();)
+        {
+            const DrawBucket &bucket = buckets[order[k]];
+            uint32_t end = k + 1;
+            while (end < order.size() && end - k < maxDrawCount && buckets[order[end]].material == bucket.material &&
+                   mesh_vertex_buffer(buckets[order[end]].mesh) == mesh_vertex_buffer(bucket.mesh) &&
+                   mesh_index_buffer(buckets[order[end]].mesh) == mesh_index_buffer(bucket.mesh))
+                ++end;
+            _draw_items.push_back({bucket.material, bucket.mesh, k, end - k, true});
+            k = end;
+        }
+    }
+    else
+    {
+        for (int b : order)
+            _draw_items.push_back({buckets[b].material, buckets[b].mesh, buckets[b].first, buckets[b].count, false});
+    }
+    for (size_t b = opaque_bucket_count; b < buckets.size(); ++b)
+        _draw_items.push_back({buckets[b].material, buckets[b].mesh, buckets[b].first, buckets[b].count, false});
+}
+
+// 录制_draw_items中[begin, end)的绘制项：(管线变化时)重新绑定材质对应的管线及描述符集合；
+// 录制的命令数累加到stats，多线程录制时每个线程用自己的stats，录完再合并
+void VenomApp::draw_objects(VkCommandBuffer cmd, FrameData &current_frame, size_t begin, size_t end, FrameStats &stats)
+{
+    // 纹理数据
+    Material *lastMaterial = nullptr;
+    VkBuffer lastVertexBuffer = VK_NULL_HANDLE, lastIndexBuffer = VK_NULL_HANDLE;
+    // 只有当要渲染的材质和上一个不同时，才要重新绑定管线；管线不同时，也要重新绑定DescriptorSet
+    auto bind_material = [&](Material *material)
+    {
+        if (material == lastMaterial)
+            return;
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+        lastMaterial = material;
+        // bind the descriptor set when changing pipeline
+        // offset for our scene buffer
+        uint32_t dynamic_uniform_offset = pad_uniform_buffer_size(sizeof(GPUSceneData)) * (_current_frame % MAX_FRAMES_IN_FLIGHT);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 0, 1, &current_frame.globalDescriptorSet, 1, &dynamic_uniform_offset);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1, &current_frame.objectDescriptorSet, 0, nullptr);
+        stats.commands += 3;
+        if (material->textureSet != VK_NULL_HANDLE)
+        {
+            // texture descriptor
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &material->textureSet, 0, nullptr);
+            ++stats.commands;
+        }
+    };
+    // 只有和上次的VertexBuffer/IndexBuffer不同时，才需要重新绑定（顶点池中的区块网格共用同一个顶点缓冲）
+    auto bind_mesh = [&](const Mesh *mesh)
+    {
+        VkBuffer vertexBuffer = mesh_vertex_buffer(mesh), indexBuffer = mesh_index_buffer(mesh);
+        if (vertexBuffer != lastVertexBuffer)
         {
             // bind the mesh vertex buffer with offset 0
             VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->_vertexBuffer._buffer, &offset);
-            lastMesh = object.mesh;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &offset);
+            lastVertexBuffer = vertexBuffer;
+            ++stats.commands;
         }
-        // vkCmdDraw后四个参数分别对应 vertexCount instanceCount firstVertex firstInstance->对应到vert shader的gl_BaseInstance
-        vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+        if (indexBuffer != lastIndexBuffer)
+        {
+            vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            lastIndexBuffer = indexBuffer;
+            ++stats.commands;
+        }
+    };
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        const DrawItem &item = _draw_items[i];
+        bind_material(item.material);
+        bind_mesh(item.mesh);
+        if (item.indirect)
+            vkCmdDrawIndexedIndirect(cmd, current_frame.indirectBuffer._buffer, item.first * sizeof(VkDrawIndexedIndirectCommand), item.count, sizeof(VkDrawIndexedIndirectCommand));
+        else // vkCmdDrawIndexed后五个参数分别对应 indexCount instanceCount firstIndex vertexOffset firstInstance（gl_InstanceIndex从firstInstance开始）
+            vkCmdDrawIndexed(cmd, item.mesh->index_count(), item.count, 0, vertex_offset(item.mesh), item.first);
+        ++stats.draws;
+        ++stats.commands;
+    }
+}
+
+// 把绘制项按顺序均分给录制线程，各自录制到本帧的二级命令缓冲（继承RenderPass），再由主命令缓冲按线程顺序执行，绘制顺序不变
+void VenomApp::draw_objects_parallel(VkCommandBuffer cmd, FrameData &current_frame, VkFramebuffer framebuffer)
+{
+    int workers = _record_workers.size();
+    static vector<FrameStats> worker_stats;
+    worker_stats.assign(workers, FrameStats());
+    _record_workers.run_all([&](int w)
+                            {
+        // 本帧的栅栏已经等过，上次录制的二级命令缓冲不再使用
+        VK_CHECK(vkResetCommandPool(_device, current_frame._recordPools[w], 0));
+        VkCommandBuffer secondary = current_frame._recordCommandBuffers[w];
+        VkCommandBufferInheritanceInfo inheritanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .renderPass = _render_pass,
+            .subpass = 0,
+            .framebuffer = framebuffer};
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            .pInheritanceInfo = &inheritanceInfo};
+        VK_CHECK(vkBeginCommandBuffer(secondary, &beginInfo));
+        draw_objects(secondary, current_frame, _draw_items.size() * w / workers, _draw_items.size() * (w + 1) / workers, worker_stats[w]);
+        VK_CHECK(vkEndCommandBuffer(secondary)); });
+    vkCmdExecuteCommands(cmd, workers, current_frame._recordCommandBuffers.data());
+    ++_frame_stats.commands;
+    for (const FrameStats &stats : worker_stats)
+    {
+        _frame_stats.draws += stats.draws;
+        _frame_stats.commands += stats.commands;
     }
 }
 
 // 执行一次绘制调用
 void VenomApp::drawcall()
 {
-    FrameData current_frame = get_current_frame();
-    update_render_resource(current_frame);
+    _frame_stats = FrameStats();
+    // 换入后台网格化完成的区块，重建被编辑的区块网格，上传新网格，释放旧网格；空槽位过多时压缩可渲染对象
+    __render_system.apply_meshed_chunks();
+    __render_system.update_dirty_chunks(__main_camera.entity.pos);
+    __render_system.sort_translucent_chunks(__main_camera.entity.pos);
+    __render_system.compact_renderables();
+    upload_chunk_meshes();
+    release_chunk_meshes(false);
+    // 提交本帧积累的复制（包括初始化时的纹理和网格），不等待；本帧的渲染在GPU上等待它们完成
+    _uploader.submit();
+
+    FrameData &current_frame = get_current_frame();
     // 1.等待GPU完成上一帧渲染，1s（1e9ns）超时丢弃；如果设置0s超时丢弃，可用于判断GPU是否在执行指令
     VK_CHECK(vkWaitForFences(_device, 1, &current_frame._renderFence, true, 1e9));
+    // 本帧槽位上次提交的GPU剔除已经完成，回读通过的物体数
+    if (current_frame.cullCandidates > 0)
+    {
+        vmaInvalidateAllocation(_allocator, current_frame.cullStatsBuffer._allocation, 0, sizeof(uint32_t));
+        _frame_stats.gpu_culled = current_frame.cullCandidates - *(uint32_t *)current_frame.cullStatsBuffer._mapped;
+    }
+    // 本帧的缓冲不再被GPU读取，可以写入
+    update_render_resource(current_frame);
     // 2.重置ResetFence以供本帧对CPU加锁
     VK_CHECK(vkResetFences(_device, 1, &current_frame._renderFence));
     // 3.GPU从Swapchain取一帧，注意持有了一个信号量，1s超时
@@ -1010,6 +1517,11 @@ void VenomApp::drawcall()
         .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT};
     VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
 
+    // 5.写入本帧的绘制数据；GPU剔除须在RenderPass之外录制
+    prepare_draws(current_frame);
+    if (_gpu_culling_frame)
+        dispatch_culling(cmd, current_frame);
+
     // 6.启动RenderPass，加入绘制指令
     // 【开放接口】清空内容的刷新画面（也就是天空）
     VkClearValue clearValue;
@@ -1037,11 +1549,20 @@ void VenomApp::drawcall()
         .clearValueCount = 2,
         .pClearValues = clearValues};
 
-    vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+    // 绘制项足够多时由录制线程写入二级命令缓冲，RenderPass只能包含二级命令缓冲
+    bool parallel = _record_workers.running() && _draw_items.size() >= RECORD_PARALLEL_MIN_ITEMS;
+    vkCmdBeginRenderPass(cmd, &rpInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
     // 【开放接口】7.RenderPass中执行：绑定渲染管线到cmd，执行绘制等指令
-    draw_objects(cmd, current_frame);
-    // 8.结束RenderPass
+    if (parallel)
+        draw_objects_parallel(cmd, current_frame, _framebuffers[swapchainImageIndex]);
+    else
+        draw_objects(cmd, current_frame, 0, _draw_items.size(), _frame_stats);
+    // 8.结束RenderPass，由本帧的深度生成下一帧剔除用的深度金字塔
     vkCmdEndRenderPass(cmd);
+    if (_gpu_culling_frame)
+        build_depth_pyramid(cmd);
+    else
+        _depth_pyramid_ready = false; // 关闭期间金字塔不再更新，重新开启后的第一帧只做视锥测试
     // finalize the command buffer (we can no longer add commands, but it can now be executed)
     VK_CHECK(vkEndCommandBuffer(cmd));
 
@@ -1049,13 +1570,21 @@ void VenomApp::drawcall()
     // prepare the submission to the queue.
     // we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
     // we will signal the _renderSemaphore, to signal that rendering has finished
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // 还要等最近一批上传完成（时间线信号量），读取顶点、索引和纹理之前的阶段可以先执行
+    VkSemaphore waitSemaphores[] = {current_frame._presentSemaphore, _uploader.semaphore()};
+    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+    uint64_t waitValues[] = {0, _uploader.submitted()}; // 二值信号量的值被忽略
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .waitSemaphoreValueCount = 2,
+        .pWaitSemaphoreValues = waitValues};
+    bool waitUpload = _uploader.semaphore() != VK_NULL_HANDLE && _uploader.submitted() > 0;
     VkSubmitInfo submit = {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = nullptr,
-        .waitSemaphoreCount = 1,                               // 等第3步GPU从swapchain取完NextImage
-        .pWaitSemaphores = &(current_frame._presentSemaphore), // 发送到GPU开始渲染
-        .pWaitDstStageMask = &waitStage,
+        .pNext = waitUpload ? &timelineInfo : nullptr,
+        .waitSemaphoreCount = waitUpload ? 2u : 1u,            // 等第3步GPU从swapchain取完NextImage
+        .pWaitSemaphores = waitSemaphores,                     // 发送到GPU开始渲染
+        .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
         .pCommandBuffers = &cmd,
         .signalSemaphoreCount = 1,
@@ -1098,7 +1627,7 @@ void VenomApp::mainLoop()
             resize_swapchain();
         }
         __physics_system.simulate(1); // 物理模拟，传入该渲染帧时间间隔
-        tok(_current_frame);
+        tok(_current_frame, "objects: " + to_string(_frame_stats.objects) + " culled: " + to_string(_frame_stats.culled) + " draws: " + to_string(_frame_stats.draws) + " commands: " + to_string(_frame_stats.commands) +  " upload: " + to_string(_frame_stats.upload_bytes) + "B" + (_gpu_culling_frame ? " gpu culled: " + to_string(_frame_stats.gpu_culled) : ""));
     }
     vkDeviceWaitIdle(_device); // 等待设备资源不再需求时结束
 }
@@ -1109,6 +1638,9 @@ void VenomApp::cleanup()
     if (_is_initialized)
     {
         vkDeviceWaitIdle(_device);
+        __mesh_workers.stop();
+        _record_workers.stop();
+        release_chunk_meshes(true);
         _main_deletion_queue.flush();
         vkDestroySurfaceKHR(_instance, _surface, nullptr); // 销毁渲染界面一定要在销毁实例之前！
         vkDestroyDevice(_device, nullptr);
@@ -1314,7 +1846,9 @@ void VenomApp::init_shadow_pipeline()
         vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_VERTEX_BIT, vertShader));
     pipelineBuilder._pipelineLayout = shadowPipelineLayout;
 
-    shadowPipeline = pipelineBuilder.build(_device, _shadow_render_pass);
+    auto buildStart = std::chrono::high_resolution_clock::now();
+    shadowPipeline = pipelineBuilder.build(_device, _shadow_render_pass, _pipeline_cache);
+    _pipeline_build_time += std::chrono::high_resolution_clock::now() - buildStart;
 
     vkDestroyShaderModule(_device, vertShader, nullptr);
     _main_deletion_queue.push_function([=]()
@@ -1323,3 +1857,243 @@ void VenomApp::init_shadow_pipeline()
             vkDestroyPipelineLayout(_device, shadowPipelineLayout, nullptr);
         });
 }
+
+// GPU剔除功能
+
+// 创建深度金字塔及其逐层视图、剔除和生成金字塔的计算管线、每帧的候选/参数/统计缓冲和描述符集
+void VenomApp::init_gpu_culling()
+{
+    // 深度金字塔第0层与深度图同尺寸，逐层减半直到1×1
+    _depth_pyramid.imageFormat = VK_FORMAT_R32_SFLOAT;
+    _depth_pyramid.imageExtent = _depth_extent;
+    _depth_pyramid_levels = std::min<uint32_t>(DEPTH_PYRAMID_MAX_LEVELS, (uint32_t)std::log2(std::max(_depth_extent.width, _depth_extent.height)) + 1);
+    VkImageCreateInfo pyramidInfo = vkinit::image_create_info(_depth_pyramid.imageFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, _depth_extent);
+    pyramidInfo.mipLevels = _depth_pyramid_levels;
+    VmaAllocationCreateInfo pyramidAllocInfo = {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+        .requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)};
+    vmaCreateImage(_allocator, &pyramidInfo, &pyramidAllocInfo, &_depth_pyramid.image, &_depth_pyramid.allocation, nullptr);
+
+    // 剔除时采样全部层，生成时每层单独作为存储图像
+    VkImageViewCreateInfo pyramidViewInfo = vkinit::image_view_create_info(_depth_pyramid.imageFormat, _depth_pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+    pyramidViewInfo.subresourceRange.levelCount = _depth_pyramid_levels;
+    VK_CHECK(vkCreateImageView(_device, &pyramidViewInfo, nullptr, &_depth_pyramid.imageView));
+    for (uint32_t level = 0; level < _depth_pyramid_levels; ++level)
+    {
+        pyramidViewInfo.subresourceRange.baseMipLevel = level;
+        pyramidViewInfo.subresourceRange.levelCount = 1;
+        VK_CHECK(vkCreateImageView(_device, &pyramidViewInfo, nullptr, &_depth_pyramid_views[level]));
+    }
+    _main_deletion_queue.push_function([=]()
+                                       {
+            for (uint32_t level = 0; level < _depth_pyramid_levels; ++level)
+                vkDestroyImageView(_device, _depth_pyramid_views[level], nullptr);
+            vkDestroyImageView(_device, _depth_pyramid.imageView, nullptr);
+            vmaDestroyImage(_allocator, _depth_pyramid.image, _depth_pyramid.allocation); });
+
+    immediate_submit([&](VkCommandBuffer cmd)
+                     {
+        VkImageMemoryBarrier imageBarrier_toGeneral = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .image = _depth_pyramid.image,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = _depth_pyramid_levels,
+                .baseArrayLayer = 0,
+                .layerCount = 1}};
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toGeneral); });
+
+    // 只用texelFetch按整数坐标读取，不需要过滤
+    VkSamplerCreateInfo pyramidSamplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST, VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    VkSampler pyramidSampler;
+    vkCreateSampler(_device, &pyramidSamplerInfo, nullptr, &pyramidSampler);
+    _main_deletion_queue.push_function([=]()
+                                       { vkDestroySampler(_device, pyramidSampler, nullptr); });
+
+    // 剔除：binding 0参数，1物体，2候选，3间接绘制命令，4实例，5统计，6深度金字塔
+    VkDescriptorSetLayoutBinding cullBindings[7];
+    cullBindings[0] = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+    for (uint32_t binding = 1; binding <= 5; ++binding)
+        cullBindings[binding] = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, binding);
+    cullBindings[6] = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 6);
+    VkDescriptorSetLayoutCreateInfo cullSetInfo = vkinit::descriptorset_layout_create_info(sizeof(cullBindings) / sizeof(VkDescriptorSetLayoutBinding), cullBindings);
+    vkCreateDescriptorSetLayout(_device, &cullSetInfo, nullptr, &_cull_set_layout);
+    // 生成金字塔：binding 0源（上一层或深度图），1目标层
+    VkDescriptorSetLayoutBinding pyramidBindings[] = {
+        vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+        vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1)};
+    VkDescriptorSetLayoutCreateInfo pyramidSetInfo = vkinit::descriptorset_layout_create_info(sizeof(pyramidBindings) / sizeof(VkDescriptorSetLayoutBinding), pyramidBindings);
+    vkCreateDescriptorSetLayout(_device, &pyramidSetInfo, nullptr, &_depth_pyramid_set_layout);
+
+    VkPipelineLayoutCreateInfo cullLayoutInfo = vkinit::pipeline_layout_create_info();
+    cullLayoutInfo.setLayoutCount = 1;
+    cullLayoutInfo.pSetLayouts = &_cull_set_layout;
+    VK_CHECK(vkCreatePipelineLayout(_device, &cullLayoutInfo, nullptr, &_cull_pipeline_layout));
+    VkPushConstantRange pyramidPushConstant = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(int32_t)};
+    VkPipelineLayoutCreateInfo pyramidLayoutInfo = vkinit::pipeline_layout_create_info();
+    pyramidLayoutInfo.setLayoutCount = 1;
+    pyramidLayoutInfo.pSetLayouts = &_depth_pyramid_set_layout;
+    pyramidLayoutInfo.pushConstantRangeCount = 1;
+    pyramidLayoutInfo.pPushConstantRanges = &pyramidPushConstant;
+    VK_CHECK(vkCreatePipelineLayout(_device, &pyramidLayoutInfo, nullptr, &_depth_pyramid_pipeline_layout));
+
+    // 计算管线只有一个着色器阶段，不需要PipelineBuilder
+    auto build_compute_pipeline = [&](const string &shader_path, VkPipelineLayout layout)
+    {
+        VkShaderModule compShader;
+        if (!load_shader_module(shader_path, &compShader))
+        {
+            std::cout << "Error when building the compute shader module " << shader_path << std::endl;
+        }
+        VkComputePipelineCreateInfo pipelineInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, compShader),
+            .layout = layout};
+        VkPipeline pipeline;
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        VK_CHECK(vkCreateComputePipelines(_device, _pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline));
+        _pipeline_build_time += std::chrono::high_resolution_clock::now() - buildStart;
+        vkDestroyShaderModule(_device, compShader, nullptr);
+        return pipeline;
+    };
+    _cull_pipeline = build_compute_pipeline(string(SHADER_DIR) + "cull_comp.spv", _cull_pipeline_layout);
+    _depth_pyramid_pipeline = build_compute_pipeline(string(SHADER_DIR) + "depth_pyramid_comp.spv", _depth_pyramid_pipeline_layout);
+    _main_deletion_queue.push_function([=]()
+                                       {
+            vkDestroyPipeline(_device, _cull_pipeline, nullptr);
+            vkDestroyPipeline(_device, _depth_pyramid_pipeline, nullptr);
+            vkDestroyPipelineLayout(_device, _cull_pipeline_layout, nullptr);
+            vkDestroyPipelineLayout(_device, _depth_pyramid_pipeline_layout, nullptr);
+            vkDestroyDescriptorSetLayout(_device, _cull_set_layout, nullptr);
+            vkDestroyDescriptorSetLayout(_device, _depth_pyramid_set_layout, nullptr); });
+
+    // 每层的源为上一层（第0层为深度图，处于RenderPass结束后的只读布局）
+    for (uint32_t level = 0; level < _depth_pyramid_levels; ++level)
+    {
+        VkDescriptorSetAllocateInfo pyramidSetAlloc = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = _descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &_depth_pyramid_set_layout};
+        vkAllocateDescriptorSets(_device, &pyramidSetAlloc, &_depth_pyramid_sets[level]);
+        VkDescriptorImageInfo sourceInfo{
+            .sampler = pyramidSampler,
+            .imageView = level == 0 ? _depth_image.imageView : _depth_pyramid_views[level - 1],
+            .imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL};
+        VkDescriptorImageInfo destinationInfo{
+            .imageView = _depth_pyramid_views[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+        VkWriteDescriptorSet writes[] = {
+            vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _depth_pyramid_sets[level], &sourceInfo, 0),
+            vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, _depth_pyramid_sets[level], &destinationInfo, 1)};
+        vkUpdateDescriptorSets(_device, sizeof(writes) / sizeof(VkWriteDescriptorSet), writes, 0, nullptr);
+    }
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        _frames[i].cullCandidateBuffer = create_buffer(sizeof(uint32_t) * 2 * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+        _frames[i].cullParamBuffer = create_buffer(sizeof(GPUCullParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
+        // 每帧由vkCmdFillBuffer清零，计算着色器累加，CPU在帧栅栏等待后读取
+        _frames[i].cullStatsBuffer = create_buffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, true);
+
+        VkDescriptorSetAllocateInfo cullSetAlloc = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = _descriptor_pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &_cull_set_layout};
+        vkAllocateDescriptorSets(_device, &cullSetAlloc, &_frames[i].cullDescriptorSet);
+        VkDescriptorBufferInfo paramInfo{_frames[i].cullParamBuffer._buffer, 0, sizeof(GPUCullParams)};
+        VkDescriptorBufferInfo objectInfo{_frames[i].objectBuffer._buffer, 0, sizeof(GPUObjectData) * MAX_OBJECTS};
+        VkDescriptorBufferInfo candidateInfo{_frames[i].cullCandidateBuffer._buffer, 0, sizeof(uint32_t) * 2 * MAX_OBJECTS};
+        VkDescriptorBufferInfo indirectInfo{_frames[i].indirectBuffer._buffer, 0, sizeof(VkDrawIndexedIndirectCommand) * MAX_OBJECTS};
+        VkDescriptorBufferInfo instanceInfo{_frames[i].instanceBuffer._buffer, 0, sizeof(uint32_t) * MAX_OBJECTS};
+        VkDescriptorBufferInfo statsInfo{_frames[i].cullStatsBuffer._buffer, 0, sizeof(uint32_t)};
+        VkDescriptorImageInfo pyramidInfo{
+            .sampler = pyramidSampler,
+            .imageView = _depth_pyramid.imageView,
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL};
+        VkWriteDescriptorSet writes[] = {
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, _frames[i].cullDescriptorSet, &paramInfo, 0),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].cullDescriptorSet, &objectInfo, 1),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].cullDescriptorSet, &candidateInfo, 2),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].cullDescriptorSet, &indirectInfo, 3),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].cullDescriptorSet, &instanceInfo, 4),
+            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _frames[i].cullDescriptorSet, &statsInfo, 5),
+            vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _frames[i].cullDescriptorSet, &pyramidInfo, 6)};
+        vkUpdateDescriptorSets(_device, sizeof(writes) / sizeof(VkWriteDescriptorSet), writes, 0, nullptr);
+    }
+    _main_deletion_queue.push_function([&]()
+                                       {
+            for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+            {
+                vmaDestroyBuffer(_allocator, _frames[i].cullCandidateBuffer._buffer, _frames[i].cullCandidateBuffer._allocation);
+                vmaDestroyBuffer(_allocator, _frames[i].cullParamBuffer._buffer, _frames[i].cullParamBuffer._allocation);
+                vmaDestroyBuffer(_allocator, _frames[i].cullStatsBuffer._buffer, _frames[i].cullStatsBuffer._allocation);
+            } });
+}
+
+// 录制GPU剔除（RenderPass之外）：清零统计，等之前的深度金字塔生成完，每个候选物体一个线程；
+// 写入的instanceCount和实例区间在之后的间接绘制和顶点着色器中读取
+void VenomApp::dispatch_culling(VkCommandBuffer cmd, FrameData &current_frame)
+{
+    vkCmdFillBuffer(cmd, current_frame.cullStatsBuffer._buffer, 0, sizeof(uint32_t), 0);
+    VkMemoryBarrier beforeCull = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &beforeCull, 0, nullptr, 0, nullptr);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline_layout, 0, 1, &current_frame.cullDescriptorSet, 0, nullptr);
+    vkCmdDispatch(cmd, (current_frame.cullCandidates + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    VkMemoryBarrier afterCull = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+    // 剔除统计在帧栅栏之后由CPU读取，着色器的写入要对主机可见
+    VkBufferMemoryBarrier statsToHost = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = current_frame.cullStatsBuffer._buffer,
+        .offset = 0,
+        .size = sizeof(uint32_t)};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &afterCull, 1, &statsToHost, 0, nullptr);
+    _frame_stats.commands += 6;
+}
+
+// RenderPass结束后由本帧的深度图逐层生成深度金字塔（深度写入到这里读取的依赖由RenderPass声明），供下一帧剔除
+void VenomApp::build_depth_pyramid(VkCommandBuffer cmd)
+{
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _depth_pyramid_pipeline);
+    for (uint32_t level = 0; level < _depth_pyramid_levels; ++level)
+    {
+        // 第0层要等本帧的剔除读完旧金字塔，之后每层要等上一层写完
+        VkMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _depth_pyramid_pipeline_layout, 0, 1, &_depth_pyramid_sets[level], 0, nullptr);
+        int32_t copy = level == 0;
+        vkCmdPushConstants(cmd, _depth_pyramid_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(int32_t), &copy);
+        uint32_t width = std::max(1u, _depth_pyramid.imageExtent.width >> level), height = std::max(1u, _depth_pyramid.imageExtent.height >> level);
+        vkCmdDispatch(cmd, (width + 7) / 8, (height + 7) / 8, 1); // 与depth_pyramid.comp中的8×8工作组一致
+        _frame_stats.commands += 4;
+    }
+    _frame_stats.commands += 1;
+    _depth_pyramid_ready = true;
+    _depth_pyramid_view_proj = _view_proj;
+}
@@ -51,6 +51,27 @@ VertexInputDescription Vertex::get_vertex_description()
     return description;
 }
 
+// 压缩顶点只有一个属性，着色器中以uvec2读取后按位解码
+VertexInputDescription ChunkVertex::get_vertex_description()
+{
+    VertexInputDescription description;
+
+    VkVertexInputBindingDescription mainBinding = {};
+    mainBinding.binding = 0;
+    mainBinding.stride = sizeof(ChunkVertex);
+    mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    description.bindings.push_back(mainBinding);
+
+    // Packed data will be stored at Location 0
+    VkVertexInputAttributeDescription dataAttribute = {};
+    dataAttribute.binding = 0;
+    dataAttribute.location = 0;
+    dataAttribute.format = VK_FORMAT_R32G32_UINT;
+    dataAttribute.offset = offsetof(ChunkVertex, data);
+    description.attributes.push_back(dataAttribute);
+    return description;
+}
+
 bool Mesh::load_from_obj(const char *filename)
 {
     // attrib will contain the vertex arrays of the file
@@ -1,7 +1,7 @@
 #include "vk_pipeline_builder.h"
 
 // 图形渲染管线初始化很繁重，所以使用封装（计算渲染管线相对简单很多）
-VkPipeline PipelineBuilder::build(VkDevice device, VkRenderPass pass)
+VkPipeline PipelineBuilder::build(VkDevice device, VkRenderPass pass, VkPipelineCache cache)
 {
     // 1.用于支持多视口、多渲染区域
     // make viewport state from our stored viewport and scissor.
@@ -47,7 +47,7 @@ VkPipeline PipelineBuilder::build(VkDevice device, VkRenderPass pass)
     // it's easy to error out on create graphics pipeline, so we handle it a bit better than the common VK_CHECK case
     VkPipeline newPipeline;
     if (vkCreateGraphicsPipelines(
-            device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
+            device, cache, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS)
     {
         std::cout << "failed to create pipeline\n";
         return VK_NULL_HANDLE; // failed to create graphics pipeline
@@ -0,0 +1,48 @@
+#include "vk_range_allocator.h"
+#include <iterator>
+
+void RangeAllocator::init(uint32_t capacity)
+{
+    _free.clear();
+    _capacity = capacity;
+    _used = 0;
+    if (capacity > 0)
+        _free[0] = capacity;
+}
+
+uint32_t RangeAllocator::allocate(uint32_t size)
+{
+    for (auto it = _free.begin(); it != _free.end(); ++it)
+    {
+        if (it->second < size)
+            continue;
+        uint32_t offset = it->first, remain = it->second - size;
+        _free.erase(it);
+        if (remain > 0)
+            _free[offset + size] = remain;
+        _used += size;
+        return offset;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+    _used -= size;
+    auto next = _free.lower_bound(offset);
+    if (next != _free.end() && offset + size == next->first)
+    { // 与后一个空闲区间合并
+        size += next->second;
+        next = _free.erase(next);
+    }
+    if (next != _free.begin())
+    { // 与前一个空闲区间合并
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+    _free[offset] = size;
+}
@@ -0,0 +1,54 @@
+#include "vk_record_workers.h"
+
+void RecordWorkers::start(int thread_count)
+{
+    _stopping = false;
+    for (int i = 0; i < thread_count; ++i)
+        _threads.emplace_back(&RecordWorkers::run, this, i);
+}
+
+void RecordWorkers::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _task_ready.notify_all();
+    for (std::thread &thread : _threads)
+        thread.join();
+    _threads.clear();
+}
+
+void RecordWorkers::run_all(const std::function<void(int)> &task)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _task = task;
+    _pending = (int)_threads.size();
+    ++_round;
+    _task_ready.notify_all();
+    _task_done.wait(lock, [this]
+                    { return _pending == 0; });
+    _task = nullptr;
+}
+
+void RecordWorkers::run(int index)
+{
+    uint64_t done_round = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _task_ready.wait(lock, [&]
+                             { return _stopping || _round != done_round; });
+            if (_stopping)
+                return;
+            done_round = _round;
+        }
+        _task(index); // 主线程在_pending归零前不会修改_task
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0)
+                _task_done.notify_one();
+        }
+    }
+}
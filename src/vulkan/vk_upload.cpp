@@ -0,0 +1,237 @@
+#include "vk_upload.h"
+#include <vk_init.h>
+#include <cstring>
+#include <utility>
+
+static const uint64_t UPLOAD_ALIGNMENT = 16; // 复制到图像时暂存区偏移须为texel大小和4的倍数
+
+void UploadManager::init(VkDevice device, VmaAllocator allocator, VkQueue queue, uint32_t queue_family, uint64_t ring_size, bool timeline)
+{
+    _device = device;
+    _allocator = allocator;
+    _queue = queue;
+    _queue_family = queue_family;
+    _ring_size = ring_size;
+    _ring = create_staging(ring_size);
+    if (!timeline)
+        return;
+    // VK_KHR_timeline_semaphore的函数不在Vulkan 1.1的核心中，需要从设备获取
+    _wait_semaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    _get_counter_value = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+        .initialValue = 0};
+    VkSemaphoreCreateInfo semaphoreInfo = vkinit::semaphore_create_info();
+    semaphoreInfo.pNext = &typeInfo;
+    VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_timeline));
+}
+
+void UploadManager::destroy()
+{
+    submit();
+    wait(_submitted);
+    for (Batch &batch : _free)
+        vkDestroyCommandPool(_device, batch.pool, nullptr);
+    _free.clear();
+    vmaDestroyBuffer(_allocator, _ring._buffer, _ring._allocation);
+    if (_timeline != VK_NULL_HANDLE)
+        vkDestroySemaphore(_device, _timeline, nullptr);
+}
+
+AllocatedBuffer UploadManager::create_staging(uint64_t size)
+{
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+    VmaAllocationCreateInfo allocInfo = {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY};
+    AllocatedBuffer staging;
+    VmaAllocationInfo allocationInfo;
+    VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &staging._buffer, &staging._allocation, &allocationInfo));
+    staging._mapped = allocationInfo.pMappedData;
+    return staging;
+}
+
+// 当前批次还没有开始录制时，复用一个已回收批次的命令池（没有则新建）并开始录制
+VkCommandBuffer UploadManager::begin_batch()
+{
+    if (_recording.cmd != VK_NULL_HANDLE)
+        return _recording.cmd;
+    if (!_free.empty())
+    {
+        _recording.pool = _free.back().pool;
+        _recording.cmd = _free.back().cmd;
+        _free.pop_back();
+    }
+    else
+    {
+        VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+        VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &_recording.pool));
+        VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_recording.pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &cmdAllocInfo, &_recording.cmd));
+    }
+    VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(_recording.cmd, &beginInfo));
+    return _recording.cmd;
+}
+
+// 在暂存环中分配size字节（不跨越缓冲末尾），空间被未完成的批次占用时等待最旧的一批；
+// 当前批次自己占满暂存环时先提交它；比整个暂存环还大的数据单独创建暂存缓冲
+char *UploadManager::allocate(uint64_t size, AllocatedBuffer &staging, VkDeviceSize &offset)
+{
+    if (size > _ring_size)
+    {
+        staging = create_staging(size);
+        _recording.large.push_back(staging);
+        offset = 0;
+        return (char *)staging._mapped;
+    }
+    uint64_t start = (_head + UPLOAD_ALIGNMENT - 1) / UPLOAD_ALIGNMENT * UPLOAD_ALIGNMENT;
+    if (start % _ring_size + size > _ring_size)
+        start = (start / _ring_size + 1) * _ring_size;
+    while (start + size > _tail + _ring_size)
+    {
+        if (!_in_flight.empty())
+            wait(_in_flight.front().value);
+        else if (_recording.cmd != VK_NULL_HANDLE)
+            submit();
+        else
+            _tail = start; // 暂存环中已经没有要读取的数据
+    }
+    _head = start + size;
+    staging = _ring;
+    offset = start % _ring_size;
+    return (char *)_ring._mapped + offset;
+}
+
+// 回收时间线值不超过completed的批次
+void UploadManager::reclaim(uint64_t completed)
+{
+    while (!_in_flight.empty() && _in_flight.front().value <= completed)
+    {
+        Batch &batch = _in_flight.front();
+        vkResetCommandPool(_device, batch.pool, 0);
+        for (AllocatedBuffer &staging : batch.large)
+            vmaDestroyBuffer(_allocator, staging._buffer, staging._allocation);
+        _tail = batch.ring_end;
+        Batch recycled;
+        recycled.pool = batch.pool;
+        recycled.cmd = batch.cmd;
+        _free.push_back(recycled);
+        _in_flight.pop_front();
+    }
+}
+
+void UploadManager::copy_to_buffer(const void *src, size_t size, VkBuffer dst, VkDeviceSize dst_offset)
+{
+    AllocatedBuffer staging;
+    VkDeviceSize offset;
+    char *data = allocate(size, staging, offset);
+    memcpy(data, src, size);
+    vmaFlushAllocation(_allocator, staging._allocation, offset, size);
+
+    VkBufferCopy copy = {
+        .srcOffset = offset,
+        .dstOffset = dst_offset,
+        .size = size};
+    vkCmdCopyBuffer(begin_batch(), staging._buffer, dst, 1, &copy);
+}
+
+void UploadManager::copy_to_image(const void *src, size_t size, VkImage dst, VkExtent3D extent)
+{
+    AllocatedBuffer staging;
+    VkDeviceSize offset;
+    char *data = allocate(size, staging, offset);
+    memcpy(data, src, size);
+    vmaFlushAllocation(_allocator, staging._allocation, offset, size);
+
+    VkCommandBuffer cmd = begin_batch();
+    // 不能直接拷贝到Image，关于Barrier（一种同步原语）参见：https://gpuopen.com/learn/vulkan-barriers-explained/
+    VkImageMemoryBarrier imageBarrier_toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = dst,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1}};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
+
+    VkBufferImageCopy copyRegion = {
+        .bufferOffset = offset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1},
+        .imageExtent = extent};
+    vkCmdCopyBufferToImage(cmd, staging._buffer, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    // 传输队列不支持着色器阶段，这里只做布局转换，着色器读取的可见性由图形队列等待时间线信号量保证
+    VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
+    imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier_toReadable.dstAccessMask = 0;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
+}
+
+void UploadManager::submit()
+{
+    if (_timeline != VK_NULL_HANDLE)
+    { // 顺便回收已经完成的批次，不等待
+        uint64_t completed;
+        VK_CHECK(_get_counter_value(_device, _timeline, &completed));
+        reclaim(completed);
+    }
+    if (_recording.cmd == VK_NULL_HANDLE)
+        return;
+    VK_CHECK(vkEndCommandBuffer(_recording.cmd));
+    _recording.value = ++_submitted;
+    _recording.ring_end = _head;
+
+    VkSubmitInfo submit = vkinit::submit_info(&_recording.cmd);
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &_recording.value};
+    if (_timeline != VK_NULL_HANDLE)
+    {
+        submit.pNext = &timelineInfo;
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &_timeline;
+    }
+    VK_CHECK(vkQueueSubmit(_queue, 1, &submit, VK_NULL_HANDLE));
+    _in_flight.push_back(std::move(_recording));
+    _recording = Batch();
+    if (_timeline == VK_NULL_HANDLE)
+    { // 没有时间线信号量时退回同步上传
+        vkQueueWaitIdle(_queue);
+        reclaim(_submitted);
+    }
+}
+
+void UploadManager::wait(uint64_t value)
+{
+    if (_timeline == VK_NULL_HANDLE)
+        return; // 每批提交时已经等待
+    VkSemaphoreWaitInfoKHR waitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+        .semaphoreCount = 1,
+        .pSemaphores = &_timeline,
+        .pValues = &value};
+    VK_CHECK(_wait_semaphores(_device, &waitInfo, UINT64_MAX));
+    reclaim(value);
+}
@@ -0,0 +1,223 @@
+// 区块网格化校验工具（无需窗口和GPU）：生成出生点附近的区块，把贪心合并网格和位运算网格覆盖的方块面与逐面渲染（RenderSystem::render_block）的结果逐面比较，
+// 并统计几种方式的顶点数、对象缓冲大小和绘制调用数；-b时再比较三种方式每秒处理的方块数；
+// -t时再用逐列标量实现校验地形噪声图在这些区块列上的结果
+// 用法：VenomMeshCheck [-r 半径] [-y 区块高度] [-b 重复次数] [-t]
+
+#include <level_system.h>
+#include <chunk_mesher.h>
+#include <player.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+static const int MESH_CHECK_DEFAULT_RADIUS = 4;  // 与CHUNK_GEN_RADIUS一致
+static const int MESH_CHECK_DEFAULT_HEIGHT = 10; // 地形最高约在y = 80以下
+
+static void show_help(const char *name)
+{
+    printf("Usage: %s [OPTIONS]\n", name);
+    printf("Options:\n");
+    printf("  -r radius   Check chunks within radius around the spawn point (default %d)\n", MESH_CHECK_DEFAULT_RADIUS);
+    printf("  -y height   Number of chunk layers from y = 0 (default %d)\n", MESH_CHECK_DEFAULT_HEIGHT);
+    printf("  -b repeat   Benchmark per-face, greedy and binary meshing over all chunks repeat times\n");
+    printf("  -t          Check the terrain noise graph against the scalar reference implementation\n");
+    printf("  -h          Show this help message\n");
+}
+
+// 逐面渲染会生成的面，判定方式与RenderSystem::render_block相同；covered存放贴图编号 + 1
+static int reference_faces(const Chunk *chunk, int covered[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN][6])
+{
+    int count = 0;
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+            {
+                Block *block = chunk->blocks[i][j][k];
+                if (!block || block->kind == BLOCK_AIR)
+                    continue;
+                for (int f = 0; f < 6; ++f)
+                {
+                    bool visible = block->transparent; // 透明方块永远渲染全部六个面
+                    glm::ivec3 near_pos = block->pos + MESH_FACE_DIR[f];
+                    if (!visible && near_pos.x >= 0 && near_pos.y >= 0 && near_pos.z >= 0)
+                    {
+                        Block *near_block = get_block(near_pos);
+                        visible = !near_block || near_block->kind == BLOCK_AIR;
+                    }
+                    if (visible)
+                    {
+                        covered[i][j][k][f] = block_face_tile(block->kind, f) + 1;
+                        ++count;
+                    }
+                }
+            }
+    return count;
+}
+
+// 四边形覆盖的方块面必须恰好是逐面渲染中的一个面且贴图相同，返回不一致的面数；会清空covered
+static int compare_quads(const std::vector<ChunkQuad> &quads, int covered[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN][6])
+{
+    int mismatch = 0;
+    for (const ChunkQuad &quad : quads)
+        for (int a = 0; a < quad.w; ++a)
+            for (int b = 0; b < quad.h; ++b)
+            {
+                glm::ivec3 p = quad.pos + a * MESH_FACE_AXIS_U[quad.face] + b * MESH_FACE_AXIS_V[quad.face];
+                bool inside = p.x >= 0 && p.x < CHUNK_LEN && p.y >= 0 && p.y < CHUNK_LEN && p.z >= 0 && p.z < CHUNK_LEN;
+                if (!inside || covered[p.x][p.y][p.z][quad.face] != quad.tile + 1)
+                {
+                    ++mismatch;
+                    continue;
+                }
+                covered[p.x][p.y][p.z][quad.face] = 0;
+            }
+    // 剩下的是没有被任何四边形覆盖的面
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+                for (int f = 0; f < 6; ++f)
+                {
+                    mismatch += covered[i][j][k][f] != 0;
+                    covered[i][j][k][f] = 0;
+                }
+    return mismatch;
+}
+
+// 与RenderSystem::render_chunk逐面渲染时每个面做的工作相同：查相邻方块、生成一个渲染对象（面的变换由着色器重建）
+static void render_chunk_per_face(const Chunk *chunk, std::vector<RenderObject> &objects)
+{
+    static Mesh face_mesh; // 代替__face_mesh
+    for (int i = 0; i < CHUNK_LEN; ++i)
+        for (int j = 0; j < CHUNK_LEN; ++j)
+            for (int k = 0; k < CHUNK_LEN; ++k)
+            {
+                Block *block = chunk->blocks[i][j][k];
+                if (!block || block->kind == BLOCK_AIR)
+                    continue;
+                for (int f = 0; f < 6; ++f)
+                {
+                    bool visible = block->transparent;
+                    glm::ivec3 near_pos = block->pos + MESH_FACE_DIR[f];
+                    if (!visible && near_pos.x >= 0 && near_pos.y >= 0 && near_pos.z >= 0)
+                    {
+                        Block *near_block = get_block(near_pos);
+                        visible = !near_block || near_block->kind == BLOCK_AIR;
+                    }
+                    if (!visible)
+                        continue;
+                    RenderObject object;
+                    object.mesh = &face_mesh;
+                    object.tile = block_face_tile(block->kind, f);
+                    object.material = nullptr;
+                    object.pos = block->pos;
+                    object.face = f;
+                    objects.push_back(object);
+                }
+            }
+}
+
+int main(int argc, char **argv)
+{
+    int radius = MESH_CHECK_DEFAULT_RADIUS, cy_count = MESH_CHECK_DEFAULT_HEIGHT, repeat = 0;
+    bool check_terrain = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            radius = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-y") && i + 1 < argc)
+            cy_count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-t"))
+            check_terrain = true;
+        else
+        {
+            show_help(argv[0]);
+            return !strcmp(argv[i], "-h") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    int spawn_cx = (int)__player_init_pos.x / CHUNK_LEN, spawn_cz = (int)__player_init_pos.z / CHUNK_LEN;
+    int cx_min = std::max(0, spawn_cx - radius), cz_min = std::max(0, spawn_cz - radius);
+    int cx_max = std::min(CHUNK_MAX_XZ - 1, spawn_cx + radius), cz_max = std::min(CHUNK_MAX_XZ - 1, spawn_cz + radius);
+    cy_count = std::min(CHUNK_MAX_Y, std::max(1, cy_count));
+
+    init_terrain_heights();
+    for (int cx = cx_min; cx <= cx_max; ++cx)
+        for (int cz = cz_min; cz <= cz_max; ++cz)
+            for (int cy = 0; cy < cy_count; ++cy)
+                generate_chunk(cx, cy, cz, false);
+
+    std::vector<Chunk *> chunks;
+    long mesh_count = 0, face_count = 0, quad_count = 0, binary_quad_count = 0, mismatch = 0;
+    static int covered[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN][6], binary_covered[CHUNK_LEN][CHUNK_LEN][CHUNK_LEN][6];
+    std::vector<ChunkQuad> quads;
+    for (int cx = cx_min; cx <= cx_max; ++cx)
+        for (int cz = cz_min; cz <= cz_max; ++cz)
+            for (int cy = 0; cy < cy_count; ++cy)
+            {
+                Chunk *chunk = get_chunk(cx, cy, cz);
+                chunks.push_back(chunk);
+                memset(covered, 0, sizeof(covered));
+                int faces = reference_faces(chunk, covered);
+                memcpy(binary_covered, covered, sizeof(covered));
+
+                quads.clear();
+                mesh_chunk_greedy(chunk, quads);
+                int greedy_mismatch = compare_quads(quads, covered);
+                mesh_count += !quads.empty();
+                quad_count += quads.size();
+
+                quads.clear();
+                mesh_chunk_binary(chunk, quads);
+                int binary_mismatch = compare_quads(quads, binary_covered);
+                binary_quad_count += quads.size();
+
+                if (greedy_mismatch || binary_mismatch)
+                    printf("Chunk (%d, %d, %d): %d greedy / %d binary mismatched faces\n", cx, cy, cz, greedy_mismatch, binary_mismatch);
+                face_count += faces;
+                mismatch += greedy_mismatch + binary_mismatch;
+            }
+
+    printf("Checked %zu chunks around (%d, %d): %ld mismatched faces\n", chunks.size(), spawn_cx, spawn_cz, mismatch);
+    printf("%-12s %12s %12s %16s %12s\n", "", "objects", "vertices", "object bytes", "draw calls");
+    printf("%-12s %12ld %12ld %16ld %12ld\n", "per-face", face_count, face_count * 4, face_count * (long)sizeof(GPUObjectData), face_count);
+    printf("%-12s %12ld %12ld %16ld %12ld\n", "greedy", mesh_count, quad_count * 4, mesh_count * (long)sizeof(GPUObjectData), mesh_count);
+    printf("%-12s %12ld %12ld %16ld %12ld\n", "binary", mesh_count, binary_quad_count * 4, mesh_count * (long)sizeof(GPUObjectData), mesh_count);
+    if (quad_count)
+        printf("Greedy meshing merged %.2f faces per quad\n", (double)face_count / quad_count);
+    printf("Chunk vertex memory: %ld bytes packed (%zu bytes per vertex), %ld bytes as Vertex (%zu bytes per vertex)\n",
+           binary_quad_count * 4 * (long)sizeof(ChunkVertex), sizeof(ChunkVertex), binary_quad_count * 4 * (long)sizeof(Vertex), sizeof(Vertex));
+
+    if (repeat > 0)
+    {
+        double block_count = (double)chunks.size() * CHUNK_LEN * CHUNK_LEN * CHUNK_LEN * repeat;
+        auto benchmark = [&](const char *name, auto &&mesh)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int r = 0; r < repeat; ++r)
+                for (Chunk *chunk : chunks)
+                    mesh(chunk);
+            double sec = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            printf("%-12s %10.2f M blocks/s %10.2f us/chunk\n", name, block_count / sec / 1e6, sec * 1e6 / (chunks.size() * repeat));
+        };
+        std::vector<RenderObject> objects;
+        benchmark("per-face", [&](Chunk *chunk)
+                  { objects.clear(); render_chunk_per_face(chunk, objects); });
+        benchmark("greedy", [&](Chunk *chunk)
+                  { quads.clear(); mesh_chunk_greedy(chunk, quads); });
+        benchmark("binary", [&](Chunk *chunk)
+                  { quads.clear(); mesh_chunk_binary(chunk, quads); });
+    }
+
+    long terrain_mismatch = 0;
+    if (check_terrain)
+    {
+        int column_count = (cx_max - cx_min + 1) * (cz_max - cz_min + 1) * CHUNK_LEN * CHUNK_LEN;
+        for (int cx = cx_min; cx <= cx_max; ++cx)
+            for (int cz = cz_min; cz <= cz_max; ++cz)
+                terrain_mismatch += check_terrain_graph(cx, cz);
+        printf("Checked terrain graph on %d columns: %ld outside tolerance\n", column_count, terrain_mismatch);
+    }
+    return mismatch || terrain_mismatch ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+// 离线世界预生成工具：多线程生成一片矩形范围内的区块并写入WORLD_DIR，游戏加载区块时直接读取
+// 用法：VenomPregen [-r 半径] [-b cx_min cz_min cx_max cz_max] [-y 区块高度] [-j 线程数]
+// 已经写入磁盘的区块会被跳过，因此中断后重新执行同一命令即可继续
+
+#include <level_system.h>
+#include <player.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const int PREGEN_DEFAULT_RADIUS = 16; // 默认以出生点为中心预生成的区块半径
+static const int PREGEN_DEFAULT_HEIGHT = 10; // 默认预生成的区块层数（地形最高约在y = 80以下）
+
+static void show_help(const char *name)
+{
+    printf("Usage: %s [OPTIONS]\n", name);
+    printf("Options:\n");
+    printf("  -r radius                     Pre-generate chunks within radius around the spawn point (default %d)\n", PREGEN_DEFAULT_RADIUS);
+    printf("  -b cx_min cz_min cx_max cz_max Pre-generate the chunk rectangle [cx_min, cx_max] * [cz_min, cz_max]\n");
+    printf("  -y height                     Number of chunk layers from y = 0 (default %d)\n", PREGEN_DEFAULT_HEIGHT);
+    printf("  -j threads                    Worker threads (default: all cores)\n");
+    printf("  -h                            Show this help message\n");
+}
+
+int main(int argc, char **argv)
+{
+    int spawn_cx = (int)__player_init_pos.x / CHUNK_LEN, spawn_cz = (int)__player_init_pos.z / CHUNK_LEN;
+    int cx_min = spawn_cx - PREGEN_DEFAULT_RADIUS, cz_min = spawn_cz - PREGEN_DEFAULT_RADIUS;
+    int cx_max = spawn_cx + PREGEN_DEFAULT_RADIUS, cz_max = spawn_cz + PREGEN_DEFAULT_RADIUS;
+    int cy_count = PREGEN_DEFAULT_HEIGHT;
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc)
+        {
+            int r = atoi(argv[++i]);
+            cx_min = spawn_cx - r, cz_min = spawn_cz - r, cx_max = spawn_cx + r, cz_max = spawn_cz + r;
+        }
+        else if (!strcmp(argv[i], "-b") && i + 4 < argc)
+        {
+            cx_min = atoi(argv[++i]), cz_min = atoi(argv[++i]), cx_max = atoi(argv[++i]), cz_max = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-y") && i + 1 < argc)
+            cy_count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            thread_count = std::max(1, atoi(argv[++i]));
+        else
+        {
+            show_help(argv[0]);
+            return !strcmp(argv[i], "-h") ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    // 限制在世界范围内（与__terrain_heights的定义域一致）
+    cx_min = std::max(0, cx_min), cz_min = std::max(0, cz_min);
+    cx_max = std::min(CHUNK_MAX_XZ - 1, cx_max), cz_max = std::min(CHUNK_MAX_XZ - 1, cz_max);
+    cy_count = std::min(CHUNK_MAX_Y, std::max(1, cy_count));
+    if (cx_min > cx_max || cz_min > cz_max)
+    {
+        printf("Empty chunk range\n");
+        return EXIT_FAILURE;
+    }
+
+    int columns_x = cx_max - cx_min + 1, columns_z = cz_max - cz_min + 1;
+    int column_count = columns_x * columns_z;
+    long total = (long)column_count * cy_count;
+    printf("Pre-generating chunks [%d, %d] * [0, %d) * [%d, %d] (%ld chunks) with %d threads into %s\n",
+           cx_min, cx_max, cy_count, cz_min, cz_max, total, thread_count, WORLD_DIR);
+
+    init_terrain_heights();
+    // 气候网格是懒计算的，并行生成前先在主线程计算完毕
+    prepare_climate_map(cx_min * CHUNK_LEN, cz_min * CHUNK_LEN, (cx_max + 1) * CHUNK_LEN, (cz_max + 1) * CHUNK_LEN);
+
+    std::atomic<int> next_column{0};
+    std::atomic<long> generated{0}, skipped{0}, failed{0};
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // 以列为任务单位：同一列的地表高度只由一个线程写入
+    auto worker = [&]()
+    {
+        int column;
+        while ((column = next_column.fetch_add(1)) < column_count)
+        {
+            int cx = cx_min + column / columns_z, cz = cz_min + column % columns_z;
+            for (int cy = 0; cy < cy_count; ++cy)
+            {
+                if (chunk_stored(cx, cy, cz))
+                {
+                    ++skipped;
+                    continue;
+                }
+                Chunk chunk(cx, cy, cz);
+                fill_chunk(&chunk);
+                if (save_chunk(&chunk))
+                    ++generated;
+                else
+                    ++failed;
+                for (int i = 0; i < CHUNK_LEN; ++i)
+                    for (int j = 0; j < CHUNK_LEN; ++j)
+                        for (int k = 0; k < CHUNK_LEN; ++k)
+                            delete chunk.blocks[i][j][k];
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i)
+        threads.emplace_back(worker);
+
+    // 主线程每秒汇报一次进度和吞吐量
+    while (generated + skipped + failed < total)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        double sec = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        double rate = generated / sec;
+        long left = total - generated - skipped - failed;
+        printf("\r%ld / %ld chunks (%.1f%%), %.1f chunks/s, %.2f M blocks/s, ETA %.0fs   ",
+               total - left, total, 100.0 * (total - left) / total, rate, rate * CHUNK_LEN_CUBIC / 1e6, rate > 0 ? left / rate : 0.0);
+        fflush(stdout);
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    double sec = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("\nDone in %.2fs: %ld generated, %ld already on disk, %ld failed, %.1f chunks/s\n",
+           sec, (long)generated, (long)skipped, (long)failed, generated / std::max(sec, 1e-9));
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}